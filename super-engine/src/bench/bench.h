@@ -0,0 +1,179 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ *  bench
+ *
+ *  A small microbenchmark harness with no dependencies. A case is a function that runs n operations. It
+ *  is calibrated until one run takes min_seconds, then timed repetitions times. The median ns per
+ *  operation is the result, the fastest run is kept for reference.
+ *
+ *      bench::Suite suite(options);
+ *      suite.run("zobrist", [&](uint64_t n) { for (uint64_t i = 0; i < n; i++) bench::keep(key(cr)); });
+ *      suite.print(std::cout);
+ *
+ *  Results go out as JSON ({"benchmarks": [{"name", "ns_per_op", "min_ns_per_op", "iterations"}]}). A
+ *  file in that format can be read back as a baseline, and compare() flags every case that got slower by
+ *  more than the threshold.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// Keeps the compiler from dropping a computation whose result is never used
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Options {
+    double min_seconds = 0.1;       // Per timed run
+    int repetitions = 5;
+    std::string filter;             // Only cases whose name contains it
+};
+
+struct Result {
+    std::string name;
+    double ns_per_op;               // Median of the repetitions
+    double min_ns_per_op;
+    uint64_t iterations;            // Per repetition
+};
+
+class Suite {
+public:
+    explicit Suite(const Options& options) : options(options) {}
+
+    template <typename Body>
+    void run(const std::string& name, Body body) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) {
+            return;
+        }
+
+        // Grow n until a run is long enough to scale from, then aim for min_seconds
+        uint64_t n = 1;
+        double seconds = time(body, n);
+        while (seconds < 0.01 && n < (1ULL << 40)) {
+            n *= seconds > 0.001 ? 10 : 100;
+            seconds = time(body, n);
+        }
+        n = std::max<uint64_t>(1, uint64_t(n * options.min_seconds / std::max(seconds, 1e-9)));
+
+        std::vector<double> ns;
+        for (int r = 0; r < std::max(1, options.repetitions); r++) {
+            ns.push_back(time(body, n) * 1e9 / n);
+        }
+        std::sort(ns.begin(), ns.end());
+        results.push_back({name, ns[ns.size() / 2], ns.front(), n});
+    }
+
+    const std::vector<Result>& get_results() const { return results; }
+
+    void print(std::ostream& out) const {
+        out << std::left << std::setw(28) << "benchmark" << std::right << std::setw(12) << "ns/op"
+            << std::setw(12) << "min" << std::setw(14) << "iterations" << "\n";
+        for (const Result& r : results) {
+            out << std::left << std::setw(28) << r.name << std::right << std::fixed << std::setprecision(2)
+                << std::setw(12) << r.ns_per_op << std::setw(12) << r.min_ns_per_op
+                << std::setw(14) << r.iterations << "\n";
+        }
+        out.unsetf(std::ios::floatfield);
+        out << std::flush;
+    }
+
+    std::string to_json() const {
+        std::ostringstream out;
+        out << "{\"benchmarks\":[";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            out << (i ? "," : "") << "\n  {\"name\":\"" << r.name << "\",\"ns_per_op\":" << r.ns_per_op
+                << ",\"min_ns_per_op\":" << r.min_ns_per_op << ",\"iterations\":" << r.iterations << "}";
+        }
+        out << "\n]}\n";
+        return out.str();
+    }
+
+private:
+    Options options;
+    std::vector<Result> results;
+
+    template <typename Body>
+    static double time(Body& body, uint64_t n) {
+        auto start = std::chrono::steady_clock::now();
+        body(n);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+};
+
+// ns_per_op by name from a file written by to_json, false if it can't be read
+inline bool read_baseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    const std::string NAME = "\"name\":\"", NS = "\"ns_per_op\":";
+    for (size_t at = text.find(NAME); at != std::string::npos; at = text.find(NAME, at)) {
+        at += NAME.size();
+        size_t end = text.find('"', at);
+        size_t ns = text.find(NS, end);
+        if (end == std::string::npos || ns == std::string::npos) {
+            return false;
+        }
+        baseline[text.substr(at, end - at)] = std::strtod(text.c_str() + ns + NS.size(), nullptr);
+    }
+    return !baseline.empty();
+}
+
+// One line per case against the baseline, "REGRESSION" where it is more than threshold_percent slower.
+// Returns the number of regressions. Cases missing on either side are listed but not counted.
+inline int compare(const std::vector<Result>& results, const std::map<std::string, double>& baseline,
+                   double threshold_percent, std::ostream& out) {
+    int regressions = 0;
+    out << std::left << std::setw(28) << "benchmark" << std::right << std::setw(12) << "baseline"
+        << std::setw(12) << "now" << std::setw(10) << "change" << "\n";
+    for (const Result& r : results) {
+        auto it = baseline.find(r.name);
+        out << std::left << std::setw(28) << r.name << std::right << std::fixed << std::setprecision(2);
+        if (it == baseline.end() || it->second <= 0) {
+            out << std::setw(12) << "-" << std::setw(12) << r.ns_per_op << std::setw(10) << "-" << "  new\n";
+            continue;
+        }
+        double change = 100.0 * (r.ns_per_op - it->second) / it->second;
+        out << std::setw(12) << it->second << std::setw(12) << r.ns_per_op << std::setw(9) << std::showpos
+            << change << "%" << std::noshowpos;
+        if (change > threshold_percent) {
+            out << "  REGRESSION";
+            regressions++;
+        } else if (change < -threshold_percent) {
+            out << "  faster";
+        }
+        out << "\n";
+    }
+    for (const auto& [name, ns] : baseline) {
+        bool ran = std::any_of(results.begin(), results.end(), [&](const Result& r) { return r.name == name; });
+        if (!ran) {
+            out << std::left << std::setw(28) << name << std::right << std::setw(12) << ns << "  not run\n";
+        }
+    }
+    out.unsetf(std::ios::floatfield);
+    out << std::flush;
+    return regressions;
+}
+
+} // namespace bench
+
+#endif // BENCH_H
@@ -0,0 +1,232 @@
+/*
+ *  Engine microbenchmarks
+ *
+ *  Times the hot primitives of the search one by one on a few representative positions: thc's
+ *  PushMove/PopMove, GenLegalMoveList and GetRepetitionCount, and SerialEngine's push_move/pop_move,
+ *  compute_zobrist_key, probe_tt/store_tt, static_eval and score_move (see bench/bench.h).
+ *
+ *      make bench-engine
+ *      ./bench-engine [--filter <name>] [--min-time <seconds>] [--repetitions <n>] [--json <file | ->]
+ *      ./bench-engine --baseline before.json [--threshold <percent>]
+ *
+ *  With --baseline, every case is compared against the ns/op stored in that file (a --json output of an
+ *  earlier build) and the exit status is 1 if any got slower by more than the threshold (5% by default).
+ */
+
+#include "bench.h"
+#include "options.h"
+#include "thc.h"
+#include "serial-engine.h"
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 b - - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 b - - 0 1",
+};
+constexpr int POSITIONS = sizeof(FENS) / sizeof(FENS[0]);
+
+// Position p keeps its eval state at this ply. push_move writes the next ply, so the positions are two
+// plies apart and a push from one never overwrites the state of the next.
+int ply_of(int p) { return 2 * p; }
+
+// A Ruy Lopez main line ending in queen moves back and forth, so GetRepetitionCount walks back through
+// a few reversible plies and finds the position twice before. It is played with PlayMove, PushMove leaves
+// the history alone.
+const char* GAME[] = {
+    "e4", "e5", "Nf3", "Nc6", "Bb5", "a6", "Ba4", "Nf6", "O-O", "Be7",
+    "Re1", "b5", "Bb3", "d6", "c3", "O-O", "h3", "Nb8", "d4", "Nbd7",
+    "Nbd2", "Bb7", "Bc2", "Re8", "Nf1", "Bf8", "Ng3", "g6", "a4", "c5",
+    "Qe2", "Qc7", "Qd1", "Qd8", "Qe2", "Qc7", "Qd1", "Qd8",
+};
+
+} // namespace
+
+// Reaches the private primitives of SerialEngine, which befriends it
+struct EngineBench {
+    SerialEngine engine;
+    thc::ChessRules boards[POSITIONS];
+    std::vector<thc::Move> moves[POSITIONS];
+
+    EngineBench() {
+        for (int p = 0; p < POSITIONS; p++) {
+            boards[p].Forsyth(FENS[p]);
+            boards[p].GenLegalMoveList(moves[p]);
+            engine.init_eval_state(boards[p], engine.eval_stack[ply_of(p)]);
+        }
+    }
+
+    void run(bench::Suite& suite) {
+        suite.run("thc push/pop", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n;) {
+                for (int p = 0; p < POSITIONS && i < n; p++) {
+                    for (thc::Move& m : moves[p]) {
+                        boards[p].PushMove(m);
+                        boards[p].PopMove(m);
+                        if (++i == n) {
+                            break;
+                        }
+                    }
+                }
+            }
+            bench::keep(boards[0].squares[0]);
+        });
+
+        suite.run("engine push/pop", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n;) {
+                for (int p = 0; p < POSITIONS && i < n; p++) {
+                    for (thc::Move& m : moves[p]) {
+                        engine.ply = ply_of(p);
+                        engine.push_move(boards[p], m);
+                        engine.pop_move(boards[p], m);
+                        if (++i == n) {
+                            break;
+                        }
+                    }
+                }
+            }
+            bench::keep(engine.eval_stack[1].psq_mg);
+        });
+
+        suite.run("GenLegalMoveList", [&](uint64_t n) {
+            std::vector<thc::Move> list;
+            for (uint64_t i = 0; i < n; i++) {
+                boards[i % POSITIONS].GenLegalMoveList(list);
+                bench::keep(list.size());
+            }
+        });
+
+        suite.run("compute_zobrist_key", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                bench::keep(engine.compute_zobrist_key(boards[i % POSITIONS]));
+            }
+        });
+
+        // Keys spread over the whole table, like the search's, so the TT misses the cache the same way
+        std::vector<uint64_t> keys(1 << 16);
+        std::mt19937_64 rng(2024);
+        for (uint64_t& k : keys) {
+            k = rng();
+        }
+        thc::Move no_move;
+        no_move.Invalid();
+
+        suite.run("store_tt", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                engine.store_tt(keys[i % keys.size()], int(i % 8), int(i), SerialEngine::TTEntry::BOUND_EXACT, no_move);
+            }
+        });
+
+        suite.run("probe_tt", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                bench::keep(engine.probe_tt(keys[i % keys.size()]));
+            }
+        });
+
+        suite.run("static_eval (classical)", [&](uint64_t n) {
+            bool exact;
+            for (uint64_t i = 0; i < n; i++) {
+                int p = int(i % POSITIONS);
+                engine.ply = ply_of(p);
+                bench::keep(engine.static_eval(boards[p], -SerialEngine::INF_SCORE, SerialEngine::INF_SCORE, exact));
+            }
+        });
+
+        suite.run("score_move", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n;) {
+                for (int p = 0; p < POSITIONS && i < n; p++) {
+                    for (const thc::Move& m : moves[p]) {
+                        bench::keep(boards[p].white ? engine.score_move<SerialEngine::WHITE>(m, boards[p])
+                                                    : engine.score_move<SerialEngine::BLACK>(m, boards[p]));
+                        if (++i == n) {
+                            break;
+                        }
+                    }
+                }
+            }
+        });
+
+        thc::ChessRules game;
+        for (const char* san : GAME) {
+            thc::Move m;
+            m.NaturalIn(&game, san);
+            game.PlayMove(m);
+        }
+        suite.run("GetRepetitionCount", [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++) {
+                bench::keep(game.GetRepetitionCount());
+            }
+        });
+    }
+};
+
+int main(int argc, char* argv[]) {
+    bench::Options options;
+    std::string json_path;
+    std::string baseline_path;
+    double threshold = 5.0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc && parse_double(argv[i + 1], options.min_seconds)
+                   && options.min_seconds > 0.0) {
+            i++;
+        } else if (arg == "--repetitions" && i + 1 < argc && parse_int(argv[i + 1], options.repetitions)
+                   && options.repetitions >= 1) {
+            i++;
+        } else if (arg == "--json" && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baseline_path = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc && parse_double(argv[i + 1], threshold) && threshold >= 0.0) {
+            i++;
+        } else {
+            std::cout << "Usage: " << argv[0] << " [--filter <name>] [--min-time <seconds>] [--repetitions <n>]"
+                      << " [--json <file | ->] [--baseline <file> [--threshold <percent>]]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baseline_path.empty() && !bench::read_baseline(baseline_path, baseline)) {
+        std::cout << "Could not read a baseline from " << baseline_path << std::endl;
+        return 1;
+    }
+
+    bench::Suite suite(options);
+    EngineBench().run(suite);
+
+    if (json_path == "-") {
+        std::cout << suite.to_json();
+    } else {
+        suite.print(std::cout);
+        if (!json_path.empty()) {
+            std::ofstream out(json_path);
+            out << suite.to_json();
+            if (!out) {
+                std::cout << "Could not write " << json_path << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    if (!baseline.empty()) {
+        std::ostream& out = json_path == "-" ? std::cerr : std::cout;
+        int regressions = bench::compare(suite.get_results(), baseline, threshold, out);
+        out << regressions << " regression" << (regressions == 1 ? "" : "s") << " over " << threshold << "%"
+            << std::endl;
+        return regressions ? 1 : 0;
+    }
+    return 0;
+}
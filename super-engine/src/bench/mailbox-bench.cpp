@@ -0,0 +1,106 @@
+/*
+ *  Mailbox kernel microbenchmark
+ *
+ *  Times the piece lookup, bitboard and piece-square kernels of mailbox.cpp against their scalar
+ *  references over a few positions, after checking that both produce the same results.
+ *
+ *      make bench-mailbox && ./bench-mailbox [iterations]
+ */
+
+#include "thc.h"
+#include "mailbox.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+namespace {
+
+const char* FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 b - - 0 1",
+};
+constexpr int POSITIONS = sizeof(FENS) / sizeof(FENS[0]);
+
+struct Result {
+    Bitboard pieces[12];
+    int psq;
+};
+
+template <typename Kernel>
+double time_kernel(const thc::ChessRules boards[], int iterations, Kernel kernel) {
+    volatile int sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        Result r = kernel(boards[i % POSITIONS]);
+        sink = sink + r.psq + static_cast<int>(r.pieces[i % 12]);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() * 1e9 / iterations;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 5000000;
+
+    PieceSquareTable table;
+    std::mt19937 rng(418);
+    for (auto& row : table) {
+        for (int& v : row) {
+            v = static_cast<int>(rng() % 201) - 100;
+        }
+    }
+
+    thc::ChessRules boards[POSITIONS];
+    for (int i = 0; i < POSITIONS; i++) {
+        boards[i].Forsyth(FENS[i]);
+    }
+
+    auto simd = [&](const thc::ChessRules& cr) {
+        Result r;
+        uint8_t pieces[64];
+        mailbox_piece_indices(cr.squares, pieces);
+        mailbox_bitboards(pieces, r.pieces);
+        r.psq = mailbox_psq_sum(pieces, table);
+        return r;
+    };
+    auto scalar = [&](const thc::ChessRules& cr) {
+        Result r;
+        uint8_t pieces[64];
+        mailbox_piece_indices_scalar(cr.squares, pieces);
+        mailbox_bitboards_scalar(pieces, r.pieces);
+        r.psq = mailbox_psq_sum_scalar(pieces, table);
+        return r;
+    };
+
+    for (auto& cr : boards) {
+        Result a = simd(cr);
+        Result b = scalar(cr);
+        bool same = a.psq == b.psq;
+        for (int p = 0; p < 12; p++) {
+            same = same && a.pieces[p] == b.pieces[p];
+        }
+        if (!same) {
+            std::cout << "Mismatch between the SIMD and scalar kernels on " << cr.ForsythPublish() << std::endl;
+            return 1;
+        }
+    }
+
+    double scalar_ns = time_kernel(boards, iterations, scalar);
+    double simd_ns = time_kernel(boards, iterations, simd);
+#if defined(__AVX2__)
+    const char* simd_name = "AVX2";
+#elif defined(__SSE4_1__)
+    const char* simd_name = "SSE4.1";
+#else
+    const char* simd_name = "scalar fallback";
+#endif
+    std::cout << "Board scan (indices + bitboards + psq), " << iterations << " iterations" << std::endl;
+    std::cout << "  scalar:  " << scalar_ns << " ns/board" << std::endl;
+    std::cout << "  " << simd_name << ": " << simd_ns << " ns/board (" << scalar_ns / simd_ns << "x)" << std::endl;
+    return 0;
+}
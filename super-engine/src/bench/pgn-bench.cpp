@@ -0,0 +1,91 @@
+/*
+ *  PGN reader benchmark
+ *
+ *  Parses a PGN file with the fast SAN matcher and again with NaturalIn only, checks that both read the
+ *  same moves and reports games per second for each.
+ *
+ *      make bench-pgn && ./bench-pgn games.pgn [threads]
+ */
+
+#include "pgn.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Order-independent digest of every move read, to compare the two matchers
+class DigestVisitor : public pgn::Visitor {
+public:
+    bool move(const thc::ChessRules& position, const thc::Move& move) override {
+        uint64_t h = uint64_t(position.full_move_count) << 32 | uint64_t(move.src) << 16 | uint64_t(move.dst) << 8
+                   | uint64_t(move.special);
+        game_digest = game_digest * 0x100000001B3ULL ^ h;
+        return true;
+    }
+
+    void end_game(bool) override {
+        digest += game_digest;
+        game_digest = 0xCBF29CE484222325ULL;
+    }
+
+    uint64_t digest = 0;
+
+private:
+    uint64_t game_digest = 0xCBF29CE484222325ULL;
+};
+
+struct Run {
+    pgn::Stats stats;
+    uint64_t digest = 0;
+    double seconds = 0.0;
+};
+
+Run parse(const char* path, int threads, bool fast) {
+    std::vector<DigestVisitor> visitors(threads);
+    std::vector<pgn::Visitor*> pointers;
+    for (DigestVisitor& v : visitors) {
+        pointers.push_back(&v);
+    }
+    pgn::Options options;
+    options.fast_san = fast;
+
+    Run run;
+    auto start = std::chrono::steady_clock::now();
+    if (!pgn::parse_file(path, pointers, options, run.stats)) {
+        std::cerr << "cannot read " << path << std::endl;
+        std::exit(1);
+    }
+    run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const DigestVisitor& v : visitors) {
+        run.digest += v.digest;
+    }
+    return run;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <pgn> [threads]" << std::endl;
+        return 1;
+    }
+    int threads = argc > 2 ? std::atoi(argv[2]) : 1;
+
+    Run slow = parse(argv[1], threads, false);
+    Run fast = parse(argv[1], threads, true);
+    if (slow.digest != fast.digest || slow.stats.moves != fast.stats.moves) {
+        std::cout << "MISMATCH between the fast matcher and NaturalIn" << std::endl;
+        return 1;
+    }
+
+    for (const Run* r : {&slow, &fast}) {
+        std::cout << (r == &slow ? "NaturalIn: " : "Fast SAN:  ")
+                  << r->stats.games << " games (" << r->stats.bad_games << " bad), " << r->stats.moves << " moves, "
+                  << r->seconds << "s, " << r->stats.games / r->seconds << " games/s, "
+                  << r->stats.bytes / r->seconds / (1 << 20) << " MB/s" << std::endl;
+    }
+    std::cout << "Speedup: " << slow.seconds / fast.seconds << "x on " << threads << " threads" << std::endl;
+    return 0;
+}
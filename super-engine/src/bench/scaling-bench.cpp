@@ -0,0 +1,230 @@
+/*
+ *  Thread scaling benchmark
+ *
+ *  Searches a fixed set of positions to a fixed depth with 1, 2, 4, ... threads, a few runs each, and
+ *  prints one CSV line per thread count (the median run) to stdout:
+ *
+ *      make bench-scaling
+ *      ./bench-scaling [--depth 6] [--threads 1,2,4,8] [--runs 3] [--fens <file>] > scaling.csv
+ *
+ *      threads, depth, positions, runs   the setup
+ *      seconds, seconds_min, seconds_max wall time of the whole set, median and range over the runs
+ *      time_to_depth                     mean seconds one search took to finish the depth
+ *      nodes, nps                        over all threads
+ *      speedup, efficiency               throughput against the first thread count, and per thread
+ *      overhead                          extra nodes per thread against the first thread count
+ *
+ *  The engine's search runs on one thread, so every thread runs its own SerialEngine through the whole
+ *  set, the same searches in the same order. The numbers show how throughput holds up as threads share the
+ *  caches, memory bandwidth and clock of the box, the ceiling for any parallel search on it. The searches
+ *  are deterministic, so the overhead stays 0 unless something leaks between threads. Searches that hit
+ *  the engine's time limit before the depth are counted and reported on stderr.
+ *
+ *  --depth goes up to the engine's MAX_DEPTH, deeper values are rejected rather than clamped so the
+ *  depth column is the depth that was searched. --fens reads one FEN per line (move counters optional).
+ */
+
+#include "options.h"
+#include "thc.h"
+#include "serial-engine.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Opening, middlegame and endgame positions with some tactics, quick enough for depth 6
+const char* DEFAULT_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 b - - 0 10",
+    "2r3k1/pp3ppp/2n1b3/3p4/3P4/2N1B3/PP3PPP/2R3K1 w - - 0 20",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 b - - 0 1",
+    "8/8/4k3/3p4/3P4/4K3/8/8 w - - 0 1",
+};
+
+struct Run {
+    double seconds = 0.0;           // Wall time of the set
+    double search_seconds = 0.0;    // Summed over the searches
+    uint64_t nodes = 0;
+    int searches = 0;
+    int time_limited = 0;           // Searches that stopped before the depth
+};
+
+// Every thread searches the whole set with its own engine. The engines are built (and their tables
+// touched) before the clock starts.
+Run run_threads(int threads, const std::vector<std::string>& fens, int depth) {
+    std::vector<Run> runs(threads);
+    std::atomic<int> ready {0};
+    std::atomic<bool> go {false};
+
+    auto worker = [&](int t) {
+        SerialEngine engine;
+        engine.set_log_output(nullptr);
+        engine.set_max_depth(depth);
+        ready++;
+        while (!go) {
+            std::this_thread::yield();
+        }
+        Run& run = runs[t];
+        for (const std::string& fen : fens) {
+            thc::ChessRules cr;
+            cr.Forsyth(fen.c_str());
+            engine.solve(cr, cr.WhiteToPlay());
+            const SearchStats& stats = engine.search_stats();
+            run.search_seconds += stats.seconds;
+            run.nodes += stats.counters.nodes;
+            run.searches++;
+            if (stats.iterations.empty() || stats.iterations.back().depth < depth) {
+                run.time_limited++;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+        pool.emplace_back(worker, t);
+    }
+    while (ready < threads) {
+        std::this_thread::yield();
+    }
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    Run total;
+    total.seconds = elapsed.count();
+    for (const Run& r : runs) {
+        total.search_seconds += r.search_seconds;
+        total.nodes += r.nodes;
+        total.searches += r.searches;
+        total.time_limited += r.time_limited;
+    }
+    return total;
+}
+
+std::vector<int> default_thread_counts() {
+    int hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> counts;
+    for (int t = 1; t < hardware; t *= 2) {
+        counts.push_back(t);
+    }
+    counts.push_back(hardware);
+    return counts;
+}
+
+bool parse_thread_counts(const std::string& list, std::vector<int>& counts) {
+    std::stringstream in(list);
+    std::string item;
+    counts.clear();
+    while (std::getline(in, item, ',')) {
+        int t;
+        if (!parse_int(item.c_str(), t) || t < 1) {
+            return false;
+        }
+        counts.push_back(t);
+    }
+    return !counts.empty();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int depth = 6;
+    int runs = 3;
+    std::vector<int> thread_counts = default_thread_counts();
+    std::string fens_path;
+    bool usage = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--depth" && i + 1 < argc && parse_int(argv[i + 1], depth) && depth >= 1
+            && depth <= SerialEngine::MAX_DEPTH) {
+            i++;
+        } else if (arg == "--runs" && i + 1 < argc && parse_int(argv[i + 1], runs) && runs >= 1) {
+            i++;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            usage |= !parse_thread_counts(argv[++i], thread_counts);
+        } else if (arg == "--fens" && i + 1 < argc) {
+            fens_path = argv[++i];
+        } else {
+            usage = true;
+        }
+    }
+    if (usage) {
+        std::cout << "Usage: " << argv[0] << " [--depth <plies, 1-" << SerialEngine::MAX_DEPTH << ">]"
+                  << " [--threads <n,n,...>] [--runs <n>] [--fens <file>]" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> fens;
+    if (fens_path.empty()) {
+        fens.assign(std::begin(DEFAULT_FENS), std::end(DEFAULT_FENS));
+    } else {
+        std::ifstream in(fens_path);
+        if (!in) {
+            std::cout << "Could not open " << fens_path << std::endl;
+            return 1;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            thc::ChessRules cr;
+            if (!line.empty() && cr.Forsyth(line.c_str())) {
+                fens.push_back(line);
+            }
+        }
+        if (fens.empty()) {
+            std::cout << "No positions in " << fens_path << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "threads,depth,positions,runs,seconds,seconds_min,seconds_max,time_to_depth,nodes,nps,"
+              << "speedup,efficiency,overhead" << std::endl;
+    double base_seconds = 0.0;
+    double base_nodes_per_thread = 0.0;
+    int base_threads = 0;
+    for (int threads : thread_counts) {
+        std::vector<Run> results;
+        for (int r = 0; r < runs; r++) {
+            results.push_back(run_threads(threads, fens, depth));
+            std::cerr << "threads " << threads << ", run " << r + 1 << ": " << results.back().seconds << "s" << std::endl;
+        }
+        std::sort(results.begin(), results.end(), [](const Run& a, const Run& b) { return a.seconds < b.seconds; });
+        const Run& median = results[results.size() / 2];
+        if (median.time_limited) {
+            std::cerr << "threads " << threads << ": " << median.time_limited << " of " << median.searches
+                      << " searches stopped at the time limit before depth " << depth << std::endl;
+        }
+
+        double nodes_per_thread = double(median.nodes) / threads;
+        if (!base_threads) {
+            base_threads = threads;
+            base_seconds = median.seconds;
+            base_nodes_per_thread = nodes_per_thread;
+        }
+        // Throughput relative to the first thread count: work done per second, each thread does the full set
+        double speedup = median.seconds > 0 ? (double(threads) / base_threads) * base_seconds / median.seconds : 0.0;
+        std::cout << threads << "," << depth << "," << fens.size() << "," << runs
+                  << "," << median.seconds << "," << results.front().seconds << "," << results.back().seconds
+                  << "," << (median.searches ? median.search_seconds / median.searches : 0.0)
+                  << "," << median.nodes
+                  << "," << uint64_t(median.seconds > 0 ? median.nodes / median.seconds : 0)
+                  << "," << speedup
+                  << "," << speedup * base_threads / threads
+                  << "," << (base_nodes_per_thread > 0 ? nodes_per_thread / base_nodes_per_thread - 1.0 : 0.0)
+                  << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include "bitboard.h"
+
+namespace {
+
+constexpr int BISHOP_DIRECTIONS[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+constexpr int ROOK_DIRECTIONS[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+// Walk each direction until the edge of the board or the first occupied square (which is included)
+Bitboard ray_attacks(int sq, Bitboard occupied, const int (&directions)[4][2]) {
+    Bitboard attacks = 0;
+    for (const auto& direction : directions) {
+        int file = sq % 8 + direction[0];
+        int row = sq / 8 + direction[1];
+        while (file >= 0 && file < 8 && row >= 0 && row < 8) {
+            Bitboard b = Bitboard(1) << (row * 8 + file);
+            attacks |= b;
+            if (occupied & b)
+                break;
+            file += direction[0];
+            row += direction[1];
+        }
+    }
+    return attacks;
+}
+
+} // namespace
+
+Bitboard bishop_attacks(int sq, Bitboard occupied) {
+    return ray_attacks(sq, occupied, BISHOP_DIRECTIONS);
+}
+
+Bitboard rook_attacks(int sq, Bitboard occupied) {
+    return ray_attacks(sq, occupied, ROOK_DIRECTIONS);
+}
@@ -0,0 +1,100 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <array>
+#include <cstdint>
+
+/*
+ *  bitboard
+ *
+ *  64 bit sets of squares. Bit i is thc square i, so a8 is bit 0 and h1 is bit 63. "North" (towards rank 8)
+ *  is therefore a shift to lower bits, which is the direction White's pawns move in.
+ */
+
+using Bitboard = uint64_t;
+
+constexpr Bitboard FILE_A_BB = 0x0101010101010101ULL;
+constexpr Bitboard FILE_H_BB = FILE_A_BB << 7;
+
+inline Bitboard square_bb(int sq) {
+    return Bitboard(1) << sq;
+}
+
+inline int popcount(Bitboard b) {
+    return __builtin_popcountll(b);
+}
+
+inline int lsb(Bitboard b) {
+    return __builtin_ctzll(b);
+}
+
+// Remove and return the lowest square of a non-empty set
+inline int pop_lsb(Bitboard& b) {
+    int sq = lsb(b);
+    b &= b - 1;
+    return sq;
+}
+
+// Files file-1, file and file+1
+inline Bitboard file_span_bb(int file) {
+    Bitboard f = FILE_A_BB << file;
+    return f | ((f & ~FILE_H_BB) << 1) | ((f & ~FILE_A_BB) >> 1);
+}
+
+// Rows strictly in front of a square from the color's point of view (towards rank 8 for White)
+inline Bitboard forward_rows_bb(int sq, bool white) {
+    int row = sq / 8;
+    if (white) {
+        return (Bitboard(1) << (row * 8)) - 1;
+    }
+    return row == 7 ? 0 : ~((Bitboard(1) << (row * 8 + 8)) - 1);
+}
+
+// Squares attacked by a set of pawns of one color
+inline Bitboard pawn_attacks(Bitboard pawns, bool white) {
+    if (white) {
+        return ((pawns & ~FILE_A_BB) >> 9) | ((pawns & ~FILE_H_BB) >> 7);
+    }
+    return ((pawns & ~FILE_A_BB) << 7) | ((pawns & ~FILE_H_BB) << 9);
+}
+
+// Squares reached by one step of each (file, row) offset that stays on the board
+template <int N>
+constexpr std::array<Bitboard, 64> leaper_table(const int (&steps)[N][2]) {
+    std::array<Bitboard, 64> table {};
+    for (int sq = 0; sq < 64; sq++) {
+        for (const auto& step : steps) {
+            int file = sq % 8 + step[0];
+            int row = sq / 8 + step[1];
+            if (file >= 0 && file < 8 && row >= 0 && row < 8) {
+                table[sq] |= Bitboard(1) << (row * 8 + file);
+            }
+        }
+    }
+    return table;
+}
+
+constexpr int KNIGHT_STEPS[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+constexpr int KING_STEPS[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+// Leaper attacks come from tables built at compile time, slider attacks are traced along the rays up to
+// the first blocker
+inline constexpr std::array<Bitboard, 64> KNIGHT_ATTACKS = leaper_table(KNIGHT_STEPS);
+inline constexpr std::array<Bitboard, 64> KING_ATTACKS = leaper_table(KING_STEPS);
+
+inline Bitboard knight_attacks(int sq) {
+    return KNIGHT_ATTACKS[sq];
+}
+
+inline Bitboard king_attacks(int sq) {
+    return KING_ATTACKS[sq];
+}
+
+Bitboard bishop_attacks(int sq, Bitboard occupied);
+Bitboard rook_attacks(int sq, Bitboard occupied);
+
+inline Bitboard queen_attacks(int sq, Bitboard occupied) {
+    return bishop_attacks(sq, occupied) | rook_attacks(sq, occupied);
+}
+
+#endif // BITBOARD_H
@@ -0,0 +1,83 @@
+/*
+ *  bookgen
+ *
+ *  Builds a Polyglot opening book for the engine's --book option from PGN files (see book/builder.h).
+ *
+ *      make bookgen
+ *      ./bookgen -o book.bin [-j <threads>] [--max-ply 30] [--min-games 1] [--max-entries N] [--temp <dir>] games.pgn...
+ *
+ *  The book uses the standard Polyglot keys, or the ones given with --keys <file>. In a
+ *  make SEARCH_TRACE=1 build, --trace <file> writes a timeline of the reader threads (see search-trace.h).
+ */
+
+#include "builder.h"
+#include "options.h"
+#include "polyglot.h"
+#include "search-trace.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    book::BuilderOptions options;
+    options.log = &std::cerr;
+    std::string output;
+    std::vector<std::string> pgn_files;
+    std::string trace_path;
+    bool usage = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc && parse_int(argv[i + 1], options.threads) && options.threads >= 0) {
+            i++;
+        } else if (arg == "--max-ply" && i + 1 < argc && parse_int(argv[i + 1], options.max_ply) && options.max_ply >= 0) {
+            i++;
+        } else if (arg == "--min-games" && i + 1 < argc && parse_int(argv[i + 1], options.min_games)
+                   && options.min_games >= 1) {
+            i++;
+        } else if (arg == "--max-entries" && i + 1 < argc && parse_unsigned(argv[i + 1], options.max_entries)
+                   && options.max_entries > 0) {
+            i++;
+        } else if (arg == "--temp" && i + 1 < argc) {
+            options.temp_dir = argv[++i];
+        } else if (arg == "--keys" && i + 1 < argc) {
+            if (!book::load_keys(argv[++i])) {
+                std::cerr << "Could not read 781 keys from " << argv[i] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-') {
+            pgn_files.push_back(arg);
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || output.empty() || pgn_files.empty()) {
+        std::cout << "Usage: " << argv[0] << " -o <book> [-j <threads>] [--max-ply <plies>] [--min-games <n>]"
+                  << " [--max-entries <n>] [--temp <dir>] [--keys <file>] [--trace <file>] <pgn>..." << std::endl;
+        return 1;
+    }
+    if (!trace_path.empty()) {
+        if (!SEARCH_TRACE_ENABLED) {
+            std::cerr << "--trace needs a build with make SEARCH_TRACE=1, no trace is written" << std::endl;
+        }
+        SEARCH_TRACE_OUTPUT(trace_path);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    book::BuilderStats stats;
+    bool ok = book::build_book(pgn_files, output, options, stats);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Games: " << stats.games << " (" << stats.bad_games << " with bad moves)"
+              << ", Positions: " << stats.positions
+              << ", Runs: " << stats.runs
+              << ", Book entries: " << stats.entries
+              << ", Time: " << elapsed.count() << "s"
+              << ", Games/s: " << (elapsed.count() > 0 ? stats.games / elapsed.count() : 0.0) << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,281 @@
+#include "builder.h"
+#include "polyglot.h"
+#include "pgn.h"
+#include "thc.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+
+#include <unistd.h>
+
+namespace book {
+
+namespace {
+
+constexpr int SHARD_BITS = 6;
+constexpr int SHARDS = 1 << SHARD_BITS;
+constexpr size_t RECORDS_PER_BATCH = 8192;
+
+struct MoveKey {
+    uint64_t key;
+    uint16_t move;
+    bool operator==(const MoveKey& other) const { return key == other.key && move == other.move; }
+};
+
+struct MoveKeyHash {
+    size_t operator()(const MoveKey& k) const { return size_t(k.key ^ (uint64_t(k.move) * 0x9E3779B97F4A7C15ULL)); }
+};
+
+struct MoveStats {
+    uint32_t score = 0;
+    uint32_t games = 0;
+};
+
+struct Shard {
+    std::mutex mutex;
+    std::unordered_map<MoveKey, MoveStats, MoveKeyHash> moves;
+};
+
+// One move of a position in a run file, runs are sorted by key and move
+struct RunRecord {
+    uint64_t key;
+    uint32_t score;
+    uint32_t games;
+    uint16_t move;
+};
+
+bool operator<(const RunRecord& a, const RunRecord& b) {
+    return a.key != b.key ? a.key < b.key : a.move < b.move;
+}
+
+class Builder {
+public:
+    Builder(const BuilderOptions& options, BuilderStats& stats) : options(options), stats(stats) {}
+
+    bool run(const std::vector<std::string>& pgn_files, const std::string& output) {
+        int threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::unique_ptr<BookVisitor>> visitors;
+        std::vector<pgn::Visitor*> pointers;
+        for (int t = 0; t < threads; t++) {
+            visitors.push_back(std::make_unique<BookVisitor>(*this));
+            pointers.push_back(visitors.back().get());
+        }
+
+        bool ok = true;
+        pgn::Stats read;
+        for (const std::string& file : pgn_files) {
+            if (!pgn::parse_file(file, pointers, pgn::Options(), read)) {
+                message("cannot read " + file);
+                ok = false;
+            }
+        }
+        for (auto& v : visitors) {
+            add(v->records);
+        }
+        stats.games = read.games;
+        stats.bad_games = read.bad_games;
+
+        std::lock_guard<std::mutex> lock(spill_mutex);
+        ok = ok && spill() && merge(output);
+        for (const std::string& run : runs) {
+            std::remove(run.c_str());
+        }
+        return ok;
+    }
+
+private:
+    void message(const std::string& text) {
+        if (options.log) {
+            *options.log << text << std::endl;
+        }
+    }
+
+    // Records the first max_ply moves of each game, handed to the shards in batches
+    class BookVisitor : public pgn::Visitor {
+    public:
+        explicit BookVisitor(Builder& builder) : builder(builder) {}
+
+        bool begin_game(const pgn::GameHeader& header) override {
+            white_score = header.result == "1-0" ? 2 : header.result == "0-1" ? 0 : header.result == "1/2-1/2" ? 1 : -1;
+            ply = 0;
+            return true;
+        }
+
+        bool move(const thc::ChessRules& position, const thc::Move& move) override {
+            if (ply++ >= builder.options.max_ply) {
+                return false;
+            }
+            RunRecord r;
+            r.key = key(position);
+            r.move = encode_move(move);
+            r.score = white_score < 0 ? 0 : position.white ? white_score : 2 - white_score;
+            r.games = 1;
+            records.push_back(r);
+            return true;
+        }
+
+        void end_game(bool) override {
+            if (records.size() >= RECORDS_PER_BATCH) {
+                builder.add(records);
+            }
+        }
+
+        std::vector<RunRecord> records;
+
+    private:
+        Builder& builder;
+        int white_score = -1;
+        int ply = 0;
+    };
+
+    // Add a batch of moves to the shards, one lock per shard, and spill if they got too full
+    void add(std::vector<RunRecord>& records) {
+        std::sort(records.begin(), records.end(), [](const RunRecord& a, const RunRecord& b) {
+            return (a.key >> (64 - SHARD_BITS)) < (b.key >> (64 - SHARD_BITS));
+        });
+        size_t added = 0;
+        for (size_t i = 0; i < records.size(); ) {
+            uint64_t id = records[i].key >> (64 - SHARD_BITS);
+            Shard& shard = shards[id];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (; i < records.size() && records[i].key >> (64 - SHARD_BITS) == id; i++) {
+                MoveStats& s = shard.moves[MoveKey {records[i].key, records[i].move}];
+                added += s.games == 0;
+                s.score += records[i].score;
+                s.games++;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            stats.positions += records.size();
+        }
+        records.clear();
+        if ((held += added) > options.max_entries && spill_mutex.try_lock()) {
+            spill();
+            spill_mutex.unlock();
+        }
+    }
+
+    // Write everything in the shards as a sorted run and clear them. Caller holds spill_mutex.
+    bool spill() {
+        std::vector<RunRecord> records;
+        for (Shard& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto& m : shard.moves) {
+                records.push_back(RunRecord {m.first.key, m.second.score, m.second.games, m.first.move});
+            }
+            shard.moves.clear();
+        }
+        held -= std::min<size_t>(held, records.size());
+        std::sort(records.begin(), records.end());
+
+        std::string path = options.temp_dir + "/bookgen-" + std::to_string(getpid()) + "-" + std::to_string(runs.size()) + ".run";
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(RunRecord));
+        runs.push_back(path);
+        if (!out) {
+            write_failed = true;
+            message("cannot write " + path);
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        stats.runs++;
+        return true;
+    }
+
+    // k-way merge of the runs, one position at a time
+    bool merge(const std::string& output) {
+        if (write_failed) {
+            return false;
+        }
+        struct Source {
+            std::ifstream in;
+            RunRecord record;
+            bool next() { return bool(in.read(reinterpret_cast<char*>(&record), sizeof(record))); }
+        };
+        std::vector<std::unique_ptr<Source>> sources;
+        auto later = [&](size_t a, size_t b) { return sources[b]->record < sources[a]->record; };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+        for (const std::string& run : runs) {
+            sources.push_back(std::make_unique<Source>());
+            sources.back()->in.open(run, std::ios::binary);
+            if (sources.back()->next()) {
+                heap.push(sources.size() - 1);
+            }
+        }
+
+        std::ofstream out(output, std::ios::binary | std::ios::trunc);
+        std::vector<RunRecord> position;
+        auto flush = [&] {
+            position.erase(std::remove_if(position.begin(), position.end(), [&](const RunRecord& r) {
+                return r.games < uint32_t(options.min_games) || r.score == 0;
+            }), position.end());
+            uint32_t top = 0;
+            for (const RunRecord& r : position) {
+                top = std::max(top, r.score);
+            }
+            std::stable_sort(position.begin(), position.end(), [](const RunRecord& a, const RunRecord& b) {
+                return a.score > b.score;
+            });
+            for (const RunRecord& r : position) {
+                uint8_t bytes[ENTRY_SIZE];
+                uint32_t weight = top > 0xFFFF ? std::max<uint32_t>(1, uint64_t(r.score) * 0xFFFF / top) : r.score;
+                write_entry(bytes, Entry {r.key, r.move, uint16_t(weight), 0});
+                out.write(reinterpret_cast<const char*>(bytes), ENTRY_SIZE);
+                stats.entries++;
+            }
+            position.clear();
+        };
+
+        while (!heap.empty()) {
+            size_t s = heap.top();
+            heap.pop();
+            const RunRecord& r = sources[s]->record;
+            if (!position.empty() && position.back().key != r.key) {
+                flush();
+            }
+            if (!position.empty() && position.back().move == r.move) {
+                position.back().score += r.score;
+                position.back().games += r.games;
+            } else {
+                position.push_back(r);
+            }
+            if (sources[s]->next()) {
+                heap.push(s);
+            }
+        }
+        flush();
+
+        if (!out) {
+            message("cannot write " + output);
+            return false;
+        }
+        return true;
+    }
+
+    const BuilderOptions& options;
+    BuilderStats& stats;
+    std::mutex stats_mutex;
+    Shard shards[SHARDS];
+    std::atomic<size_t> held {0};
+    std::mutex spill_mutex;
+    std::vector<std::string> runs;
+    bool write_failed = false;
+};
+
+} // namespace
+
+bool build_book(const std::vector<std::string>& pgn_files, const std::string& output,
+                const BuilderOptions& options, BuilderStats& stats) {
+    Builder builder(options, stats);
+    return builder.run(pgn_files, output);
+}
+
+} // namespace book
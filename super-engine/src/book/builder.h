@@ -0,0 +1,49 @@
+#ifndef BOOK_BUILDER_H
+#define BOOK_BUILDER_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ *  book builder
+ *
+ *  Builds a Polyglot book (see polyglot.h) from PGN files. The files are read by the pgn reader's
+ *  threads, and for every position of the first max_ply plies of a game each thread counts how often
+ *  each move was played and how it scored (2 for a win, 1 for a draw, from the mover's side). The
+ *  counts go into hash maps sharded by position key in batches, so threads only contend when they hit
+ *  the same shard.
+ *
+ *  When the maps hold more than max_entries moves they are sorted and spilled to a run file in
+ *  temp_dir and cleared, which bounds memory. At the end the runs are merged. Equal moves are summed,
+ *  rare moves dropped and the weights of each position scaled into 16 bits before the sorted book is
+ *  written.
+ */
+
+namespace book {
+
+struct BuilderOptions {
+    int threads = 0;                    // Worker threads, 0 for one per hardware thread
+    int max_ply = 30;                   // Positions deeper into the game aren't recorded
+    int min_games = 1;                  // Moves played fewer times are left out
+    size_t max_entries = 1 << 22;       // Moves held in memory before spilling a run
+    std::string temp_dir = "/tmp";
+    std::ostream* log = nullptr;
+};
+
+struct BuilderStats {
+    uint64_t games = 0;
+    uint64_t bad_games = 0;             // Stopped at an illegal or unreadable move, the plies before it count
+    uint64_t positions = 0;
+    uint64_t runs = 0;
+    uint64_t entries = 0;               // Written to the book
+};
+
+// Build the book in output from the PGN files, false on an I/O error
+bool build_book(const std::vector<std::string>& pgn_files, const std::string& output,
+                const BuilderOptions& options, BuilderStats& stats);
+
+} // namespace book
+
+#endif // BOOK_BUILDER_H
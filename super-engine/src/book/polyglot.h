@@ -0,0 +1,80 @@
+#ifndef POLYGLOT_H
+#define POLYGLOT_H
+
+#include "thc.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ *  polyglot
+ *
+ *  Opening books in the Polyglot .bin layout: 16 byte big-endian entries (key, move, weight, learn) sorted
+ *  by key, where the key is a Zobrist hash over 781 random numbers (768 piece-squares, 4 castling rights,
+ *  8 en passant files, 1 side to move). The book is mapped read-only and the entries of a position found
+ *  by binary search.
+ *
+ *  The keys are the standard Polyglot Random64 table, so books from bookgen and other Polyglot tools
+ *  work alike. load_keys replaces them for books built with a different table, given as a text file of
+ *  781 hex numbers in the Polyglot order.
+ */
+
+namespace book {
+
+constexpr int RANDOM_COUNT = 781;
+
+// Replace the key table with the 781 hex numbers in a text file, false (table unchanged) if there aren't
+// 781 or one of them doesn't parse
+bool load_keys(const std::string& path);
+
+// Polyglot key of a position. The en passant file only counts when a pawn can actually capture.
+uint64_t key(const thc::ChessRules& cr);
+
+// Polyglot move encoding: to file, to rank, from file, from rank (3 bits each, rank 1 = 0), promotion
+// piece (1-4 = NBRQ). Castling is the king taking its own rook (e1h1).
+uint16_t encode_move(const thc::Move& move);
+
+// The legal move matching a book move, false if there is none
+bool decode_move(thc::ChessRules& cr, uint16_t move, thc::Move& out);
+
+struct Entry {
+    uint64_t key;
+    uint16_t move;
+    uint16_t weight;
+    uint32_t learn;
+};
+
+constexpr int ENTRY_SIZE = 16;
+
+void write_entry(uint8_t* out, const Entry& e);
+Entry read_entry(const uint8_t* in);
+
+class Book {
+public:
+    Book() = default;
+    ~Book();
+    Book(const Book&) = delete;
+    Book& operator=(const Book&) = delete;
+
+    // Map a book file, replacing the current one. False (and no book) if it can't be mapped or its size
+    // isn't a whole number of entries.
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return entries != nullptr; }
+
+    // Legal book moves of the position with their weights, in book order
+    std::vector<std::pair<thc::Move, int>> probe(thc::ChessRules& cr) const;
+
+    // A book move picked at random in proportion to the weights, false if the position isn't in the book
+    bool pick(thc::ChessRules& cr, std::mt19937_64& rng, thc::Move& move) const;
+
+private:
+    const uint8_t* entries = nullptr;
+    size_t count = 0;
+    size_t size = 0;
+};
+
+} // namespace book
+
+#endif // POLYGLOT_H
@@ -0,0 +1,389 @@
+#include "dataset.h"
+#include "options.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dataset {
+
+namespace {
+
+// What one byte of the square stream unpacks to. The stream is 2 bit units: "10" is an empty square and
+// any other unit starts a 4 bit piece code (thc's Compress), which may carry over into the next byte.
+struct alignas(8) UnpackEntry {
+    char squares[4] {};
+    uint8_t count = 0;
+    uint16_t next = 0;          // Row of the next byte: 256 * its state, see CARRY_UNIT
+};
+
+constexpr char PIECE_OF_CODE[16] = {'R', 'N', 'B', 'Q', 'K', 'P', 'r', 'n', ' ', ' ', ' ', ' ', 'b', 'q', 'k', 'p'};
+
+constexpr int UNIT_EMPTY = 2;
+
+// Unfinished piece code unit of a carry state
+constexpr int CARRY_UNIT[4] = {-1, 0, 1, 3};
+
+struct UnpackTable {
+    UnpackEntry entries[4 * 256];
+
+    constexpr UnpackTable() : entries() {
+        for (int carry = 0; carry < 4; carry++) {
+            for (int byte = 0; byte < 256; byte++) {
+                UnpackEntry& e = entries[256 * carry + byte];
+                int pending = CARRY_UNIT[carry];
+                for (int shift = 6; shift >= 0; shift -= 2) {
+                    int unit = byte >> shift & 3;
+                    if (pending >= 0) {
+                        e.squares[e.count++] = PIECE_OF_CODE[pending << 2 | unit];
+                        pending = -1;
+                    } else if (unit == UNIT_EMPTY) {
+                        e.squares[e.count++] = ' ';
+                    } else {
+                        pending = unit;
+                    }
+                }
+                e.next = 256 * (pending < 0 ? 0 : pending == 3 ? 3 : pending + 1);
+            }
+        }
+    }
+};
+
+constexpr UnpackTable UNPACK = UnpackTable();
+
+constexpr int BATCH = 4;
+
+// Board chars of the squares as stored: kings, en passant and castling still in their Compress encoding.
+// Each byte's table entry depends on the one before, so a batch of positions is unpacked side by side to
+// keep several of those chains in flight.
+void unpack_squares(const Record* records, char squares[BATCH][64 + 4]) {
+    int sq[BATCH] = {};
+    int row[BATCH] = {};
+    for (int i = 0; i < 24; i++) {
+        for (int r = 0; r < BATCH; r++) {
+            const UnpackEntry& e = UNPACK.entries[row[r] + records[r].position.storage[i]];
+            std::memcpy(squares[r] + sq[r], e.squares, 4);
+            sq[r] = std::min(sq[r] + e.count, 64);
+            row[r] = e.next;
+        }
+    }
+    for (int r = 0; r < BATCH; r++) {
+        std::memset(squares[r] + sq[r], ' ', 64 - sq[r]);
+    }
+}
+
+// Piece indices, see mailbox.h
+enum : uint8_t { W_PAWN = 0, W_ROOK = 3, W_KING = 5, B_PAWN = 6, B_ROOK = 9, B_KING = 11 };
+
+void set_piece(Board& b, int sq, uint8_t piece) {
+    if (b.pieces[sq] != MAILBOX_EMPTY) {
+        b.bitboards[b.pieces[sq]] &= ~square_bb(sq);
+    }
+    if (piece != MAILBOX_EMPTY) {
+        b.bitboards[piece] |= square_bb(sq);
+    }
+    b.pieces[sq] = piece;
+}
+
+// Undo the rest of the Compress encoding the way ChessPosition::Decompress does, using the bitboards to
+// find the few squares involved
+void decode_specials(Board& b) {
+    // Two kings of one colour mean Black to move, the second of them is the other colour
+    b.white = true;
+    for (uint8_t king : {W_KING, B_KING}) {
+        Bitboard kings = b.bitboards[king];
+        if (kings & (kings - 1)) {
+            b.white = false;
+            set_piece(b, 63 - __builtin_clzll(kings), king == W_KING ? B_KING : W_KING);
+        }
+    }
+
+    // En passant: a pawn of the side not to move on the mover's own back rank, the real occupant of that
+    // square was moved to the pushed pawn's square
+    b.en_passant = -1;
+    Bitboard marker = b.bitboards[B_PAWN] & 0xFFULL;
+    int pushed = marker ? __builtin_ctzll(marker) + 24 : 0;
+    if (!marker) {
+        marker = b.bitboards[W_PAWN] & 0xFFULL << 56;
+        pushed = marker ? __builtin_ctzll(marker) - 24 : 0;
+    }
+    if (marker) {
+        int sq = __builtin_ctzll(marker);
+        uint8_t pawn = b.pieces[sq];
+        set_piece(b, sq, b.pieces[pushed]);
+        set_piece(b, pushed, pawn);
+        b.en_passant = int8_t(pawn == B_PAWN ? sq + 16 : sq - 16);
+    }
+
+    // Castling: an enemy pawn on the rook's home square
+    b.castling = 0;
+    if (b.pieces[thc::e1] == W_KING) {
+        if (b.pieces[thc::h1] == B_PAWN) {
+            set_piece(b, thc::h1, W_ROOK);
+            b.castling |= 1;
+        }
+        if (b.pieces[thc::a1] == B_PAWN) {
+            set_piece(b, thc::a1, W_ROOK);
+            b.castling |= 2;
+        }
+    }
+    if (b.pieces[thc::e8] == B_KING) {
+        if (b.pieces[thc::h8] == W_PAWN) {
+            set_piece(b, thc::h8, B_ROOK);
+            b.castling |= 4;
+        }
+        if (b.pieces[thc::a8] == W_PAWN) {
+            set_piece(b, thc::a8, B_ROOK);
+            b.castling |= 8;
+        }
+    }
+}
+
+struct Operation {
+    std::string opcode;
+    std::string operand;        // Operands after the opcode, without the quotes of a single string operand
+};
+
+// The EPD operations after the FEN. Each one ends with ';' (the last may leave it out), a ';' inside a
+// quoted string doesn't end it.
+std::vector<Operation> split_operations(std::string_view text) {
+    std::vector<Operation> operations;
+    size_t at = 0;
+    while (at < text.size()) {
+        size_t end = at;
+        bool quoted = false;
+        while (end < text.size() && (quoted || text[end] != ';')) {
+            quoted ^= text[end] == '"';
+            end++;
+        }
+        std::string_view op = text.substr(at, end - at);
+        at = end + 1;
+
+        size_t start = op.find_first_not_of(" \t\r\n");
+        if (start == std::string_view::npos) {
+            continue;
+        }
+        op = op.substr(start, op.find_last_not_of(" \t\r\n") + 1 - start);
+        size_t space = std::min(op.find_first_of(" \t"), op.size());
+        std::string_view operand = op.substr(space);
+        operand.remove_prefix(std::min(operand.find_first_not_of(" \t"), operand.size()));
+        if (operand.size() >= 2 && operand.front() == '"' && operand.back() == '"') {
+            operand = operand.substr(1, operand.size() - 2);
+        }
+        operations.push_back({std::string(op.substr(0, space)), std::string(operand)});
+    }
+    return operations;
+}
+
+// A game result as c9 gives it ("1-0") or in brackets ("[1.0]", "[1-0]")
+Result result_of(std::string_view text) {
+    if (text == "1-0" || text == "[1.0]" || text == "[1-0]") {
+        return RESULT_WHITE_WIN;
+    }
+    if (text == "0-1" || text == "[0.0]" || text == "[0-1]") {
+        return RESULT_BLACK_WIN;
+    }
+    if (text == "1/2-1/2" || text == "[0.5]" || text == "[1/2-1/2]") {
+        return RESULT_DRAW;
+    }
+    return RESULT_UNKNOWN;
+}
+
+} // namespace
+
+Record make_record(const thc::ChessRules& cr, int score, Result result) {
+    Record r {};
+    cr.Compress(r.position);
+    r.score = int16_t(score == NO_SCORE ? NO_SCORE : std::clamp(score, INT16_MIN + 1, int(INT16_MAX)));
+    r.result = result;
+    r.half_move_clock = uint8_t(std::clamp(cr.half_move_clock, 0, 255));
+    r.full_move_count = uint16_t(std::clamp(cr.full_move_count, 1, 0xFFFF));
+    return r;
+}
+
+void decode(const Record& record, thc::ChessRules& cr) {
+    thc::ChessPosition p;
+    p.Decompress(record.position);
+    p.half_move_clock = record.half_move_clock;
+    p.full_move_count = record.full_move_count;
+    for (int sq = 0; sq < 64; sq++) {
+        if (p.squares[sq] == 'K') {
+            p.wking_square = thc::Square(sq);
+        } else if (p.squares[sq] == 'k') {
+            p.bking_square = thc::Square(sq);
+        }
+    }
+    cr = p;
+}
+
+bool parse_epd(const std::string& line, Record& record) {
+    std::istringstream in(line);
+    std::string fields[6];
+    for (int i = 0; i < 4; i++) {
+        if (!(in >> fields[i])) {
+            return false;
+        }
+    }
+    // Move counters, if both are there
+    auto position = [&] { return in.eof() ? line.size() : size_t(in.tellg()); };
+    size_t ops = position();
+    if (in >> fields[4] >> fields[5] && fields[4].find_first_not_of("0123456789") == std::string::npos
+        && fields[5].find_first_not_of("0123456789") == std::string::npos) {
+        ops = position();
+    } else {
+        fields[4] = "0";
+        fields[5] = "1";
+    }
+    std::string fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3] + " " + fields[4] + " " + fields[5];
+    thc::ChessRules cr;
+    if (!cr.Forsyth(fen.c_str())) {
+        return false;
+    }
+
+    // Opcodes are matched whole, so "acd" or a "ce" inside a comment string isn't taken for a score
+    int score = NO_SCORE;
+    Result result = RESULT_UNKNOWN;
+    for (const Operation& op : split_operations(std::string_view(line).substr(ops))) {
+        int ce;
+        if (op.opcode == "ce" && parse_int(op.operand.c_str(), ce)) {
+            score = cr.white ? ce : -ce;
+        } else if (op.opcode == "c9" || op.opcode[0] == '[') {
+            Result r = result_of(op.opcode == "c9" ? op.operand : op.opcode);
+            result = r != RESULT_UNKNOWN ? r : result;
+        }
+    }
+    record = make_record(cr, score, result);
+    return true;
+}
+
+std::string format_epd(const Record& record) {
+    thc::ChessRules cr;
+    decode(record, cr);
+    std::string line = cr.ForsythPublish();
+    if (record.score != NO_SCORE) {
+        line += " ce " + std::to_string(cr.white ? record.score : -record.score) + ";";
+    }
+    static const char* const RESULTS[] = {"0-1", "1/2-1/2", "1-0"};
+    if (record.result < RESULT_UNKNOWN) {
+        line += std::string(" c9 \"") + RESULTS[record.result] + "\";";
+    }
+    return line;
+}
+
+void decode_boards(const Record* records, size_t count, Board* boards) {
+    for (size_t i = 0; i < count; i += BATCH) {
+        Record batch[BATCH];
+        size_t n = std::min<size_t>(BATCH, count - i);
+        std::memcpy(batch, records + i, n * sizeof(Record));
+        std::memset(batch + n, 0, (BATCH - n) * sizeof(Record));
+
+        char squares[BATCH][64 + 4];
+        unpack_squares(batch, squares);
+        for (size_t r = 0; r < n; r++) {
+            Board& b = boards[i + r];
+            mailbox_piece_indices(squares[r], b.pieces);
+            mailbox_bitboards(b.pieces, b.bitboards);
+            decode_specials(b);
+        }
+    }
+}
+
+Reader::~Reader() {
+    close();
+}
+
+bool Reader::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(FileHeader)) {
+        void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (m != MAP_FAILED) {
+            base = m;
+            mapped = st.st_size;
+        }
+    }
+    ::close(fd);
+    if (!base) {
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, "POSD", 4) != 0 || header.version != FILE_VERSION
+        || header.record_size != sizeof(Record)
+        || header.records != (mapped - sizeof(FileHeader)) / sizeof(Record)) {
+        close();
+        return false;
+    }
+    records = reinterpret_cast<const Record*>(static_cast<const uint8_t*>(base) + sizeof(FileHeader));
+    count = header.records;
+    return true;
+}
+
+void Reader::close() {
+    if (base) {
+        munmap(base, mapped);
+    }
+    base = nullptr;
+    mapped = 0;
+    records = nullptr;
+    count = 0;
+}
+
+std::vector<uint64_t> Reader::shuffled(uint64_t seed) const {
+    std::vector<uint64_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(seed));
+    return order;
+}
+
+Writer::~Writer() {
+    close();
+}
+
+bool Writer::open(const std::string& path) {
+    close();
+    file = std::fopen(path.c_str(), "wb");
+    count = 0;
+    failed = false;
+    FileHeader header {};
+    return file && std::fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+bool Writer::add(const Record& record) {
+    if (!file || std::fwrite(&record, sizeof(record), 1, file) != 1) {
+        failed = true;
+        return false;
+    }
+    count++;
+    return true;
+}
+
+bool Writer::close() {
+    if (!file) {
+        return !failed;
+    }
+    FileHeader header {};
+    std::memcpy(header.magic, "POSD", 4);
+    header.version = FILE_VERSION;
+    header.records = count;
+    header.record_size = sizeof(Record);
+    failed |= std::fseek(file, 0, SEEK_SET) != 0 || std::fwrite(&header, sizeof(header), 1, file) != 1;
+    failed |= std::fclose(file) != 0;
+    file = nullptr;
+    return !failed;
+}
+
+} // namespace dataset
@@ -0,0 +1,131 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include "thc.h"
+#include "mailbox.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ *  dataset
+ *
+ *  Position datasets for tuning and training in a fixed-size binary layout: a 64 byte header and 32 byte
+ *  records of a thc::CompressedPosition (board, side to move, castling and en passant in 24 bytes) with
+ *  the score, the game result and the move counters. A Reader maps the file read-only for random access
+ *  and shuffled passes. Records are written and read in the host's byte order.
+ *
+ *  decode_boards unpacks records in bulk straight into piece indices and bitboards: the 2/4 bit square
+ *  codes are unpacked a byte at a time with a lookup table, several records side by side, the mailbox
+ *  kernels (SSE4.1/AVX2) turn the squares into piece indices and bitboards, and the side to move,
+ *  castling and en passant are read off the bitboards. Reader::position goes through thc's Decompress.
+ */
+
+namespace dataset {
+
+struct FileHeader {
+    char magic[4];              // "POSD"
+    uint32_t version;
+    uint64_t records;
+    uint32_t record_size;
+    uint8_t pad[44];
+};
+
+static_assert(sizeof(FileHeader) == 64, "dataset header must be 64 bytes");
+
+constexpr uint32_t FILE_VERSION = 1;
+
+constexpr int16_t NO_SCORE = INT16_MIN;
+
+// Game result from White's point of view
+enum Result : uint8_t { RESULT_BLACK_WIN = 0, RESULT_DRAW = 1, RESULT_WHITE_WIN = 2, RESULT_UNKNOWN = 3 };
+
+struct Record {
+    thc::CompressedPosition position;
+    int16_t score;              // Centipawns from White's point of view like the engine, NO_SCORE if unknown
+    uint8_t result;             // Result
+    uint8_t half_move_clock;    // Capped at 255
+    uint16_t full_move_count;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(Record) == 32, "dataset records must be 32 bytes");
+
+Record make_record(const thc::ChessRules& cr, int score, Result result);
+
+// Board, side to move, castling and en passant of a record, with its move counters
+void decode(const Record& record, thc::ChessRules& cr);
+
+// A position line of a text dataset: FEN (the move counters may be left out) followed by EPD operations
+// ending in ';'. "ce <centipawns>;" (side to move's point of view) gives the score and "c9 \"1-0\";" or a
+// result in brackets ("[1.0]", "[0.5]", "[0-1]") the result, other operations are skipped. False if the
+// FEN can't be read.
+bool parse_epd(const std::string& line, Record& record);
+
+// The record as a FEN line with ce and c9 opcodes for what is known
+std::string format_epd(const Record& record);
+
+// A record unpacked for training code
+struct Board {
+    uint8_t pieces[64];         // Piece indices as in mailbox.h, MAILBOX_EMPTY for an empty square
+    Bitboard bitboards[12];     // By piece index
+    bool white;                 // White to move
+    uint8_t castling;           // Bits 0-3: White short, White long, Black short, Black long
+    int8_t en_passant;          // Target square (thc numbering), -1 if none
+};
+
+void decode_boards(const Record* records, size_t count, Board* boards);
+
+class Reader {
+public:
+    Reader() = default;
+    ~Reader();
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // Map a dataset file, replacing the current one. False (and no dataset) if it can't be mapped or its
+    // header doesn't match its size.
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return records != nullptr; }
+
+    uint64_t size() const { return count; }
+    const Record& operator[](uint64_t i) const { return records[i]; }
+    const Record* data() const { return records; }
+
+    void position(uint64_t i, thc::ChessRules& cr) const { decode(records[i], cr); }
+
+    // The record numbers in a random order, the same for the same seed
+    std::vector<uint64_t> shuffled(uint64_t seed) const;
+
+private:
+    const Record* records = nullptr;
+    uint64_t count = 0;
+    void* base = nullptr;
+    size_t mapped = 0;
+};
+
+// Appends records to a new file, the header count is filled in by close
+class Writer {
+public:
+    Writer() = default;
+    ~Writer();
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    bool open(const std::string& path);
+    bool add(const Record& record);
+    bool close();       // False if anything failed to write
+
+    uint64_t size() const { return count; }
+
+private:
+    std::FILE* file = nullptr;
+    uint64_t count = 0;
+    bool failed = false;
+};
+
+} // namespace dataset
+
+#endif // DATASET_H
@@ -0,0 +1,123 @@
+/*
+ *  posdata
+ *
+ *  Converts position datasets between EPD/FEN text and the binary layout of dataset/dataset.h.
+ *
+ *      make posdata
+ *      ./posdata pack -o data.bin positions.epd...     text to binary, unreadable lines are counted and skipped
+ *      ./posdata unpack data.bin                       binary to text on stdout
+ *      ./posdata shuffle -o out.bin [--seed N] data.bin
+ *
+ *  Text lines are a FEN followed by "ce <cp>;" and "c9 \"1-0\";" opcodes or a bracketed result ("[0.5]").
+ */
+
+#include "dataset.h"
+#include "options.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+int pack(const std::string& output, const std::vector<std::string>& inputs) {
+    dataset::Writer writer;
+    if (!writer.open(output)) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    uint64_t bad = 0;
+    for (const std::string& input : inputs) {
+        std::ifstream in(input);
+        if (!in) {
+            std::cerr << "Cannot read " << input << std::endl;
+            return 1;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            dataset::Record record;
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            if (dataset::parse_epd(line, record)) {
+                writer.add(record);
+            } else {
+                bad++;
+            }
+        }
+    }
+    uint64_t records = writer.size();
+    bool ok = writer.close();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Records: " << records << " (" << bad << " bad lines skipped), Time: " << elapsed.count() << "s"
+              << std::endl;
+    return ok ? 0 : 1;
+}
+
+int unpack(const std::string& input) {
+    dataset::Reader reader;
+    if (!reader.open(input)) {
+        std::cerr << "Cannot open dataset " << input << std::endl;
+        return 1;
+    }
+    for (uint64_t i = 0; i < reader.size(); i++) {
+        std::cout << dataset::format_epd(reader[i]) << "\n";
+    }
+    return 0;
+}
+
+int shuffle(const std::string& output, const std::string& input, uint64_t seed) {
+    dataset::Reader reader;
+    if (!reader.open(input)) {
+        std::cerr << "Cannot open dataset " << input << std::endl;
+        return 1;
+    }
+    dataset::Writer writer;
+    if (!writer.open(output)) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return 1;
+    }
+    for (uint64_t i : reader.shuffled(seed)) {
+        writer.add(reader[i]);
+    }
+    return writer.close() ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+    std::string output;
+    uint64_t seed = 1;
+    std::vector<std::string> inputs;
+    bool usage = false;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--seed" && i + 1 < argc && parse_unsigned(argv[i + 1], seed)) {
+            i++;
+        } else if (!arg.empty() && arg[0] != '-') {
+            inputs.push_back(arg);
+        } else {
+            usage = true;
+        }
+    }
+
+    if (!usage && command == "pack" && !output.empty() && !inputs.empty()) {
+        return pack(output, inputs);
+    }
+    if (!usage && command == "unpack" && output.empty() && inputs.size() == 1) {
+        return unpack(inputs[0]);
+    }
+    if (!usage && command == "shuffle" && !output.empty() && inputs.size() == 1) {
+        return shuffle(output, inputs[0], seed);
+    }
+    std::cout << "Usage: " << argv[0] << " pack -o <dataset> <epd>...\n"
+              << "       " << argv[0] << " unpack <dataset>\n"
+              << "       " << argv[0] << " shuffle -o <dataset> [--seed <n>] <dataset>" << std::endl;
+    return 1;
+}
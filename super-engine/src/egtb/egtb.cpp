@@ -0,0 +1,267 @@
+#include "egtb.h"
+#include "index.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace egtb {
+
+namespace {
+
+// One table file, mapped on first use
+struct Table {
+    std::string path;
+    Material material;
+    std::atomic<bool> ready {false};
+    bool failed = false;
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    const uint8_t* wdl = nullptr;
+    const uint8_t* dtm = nullptr;
+};
+
+std::map<std::string, std::unique_ptr<Table>> tables;
+std::mutex map_mutex;
+int largest = 0;
+thread_local Stats probe_stats;   // Each search thread counts its own probes
+
+void release_tables() {
+    for (auto& entry : tables) {
+        if (entry.second->base) {
+            munmap(const_cast<uint8_t*>(entry.second->base), entry.second->size);
+        }
+    }
+    tables.clear();
+    largest = 0;
+}
+
+// Map the file and check its header on first use, later calls only check the flag
+bool map_file(Table& t) {
+    if (t.ready.load(std::memory_order_acquire)) {
+        return !t.failed;
+    }
+
+    std::lock_guard<std::mutex> lock(map_mutex);
+    if (t.ready.load(std::memory_order_relaxed)) {
+        return !t.failed;
+    }
+
+    t.failed = true;
+    int fd = open(t.path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(FileHeader)) {
+        void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base != MAP_FAILED) {
+            t.base = static_cast<const uint8_t*>(base);
+            t.size = st.st_size;
+
+            FileHeader header;
+            std::memcpy(&header, t.base, sizeof(header));
+            uint64_t entries = t.material.size();
+            if (std::memcmp(header.magic, "418E", 4) == 0 && header.version == FILE_VERSION
+                && header.entries == entries && t.material.name() == header.material
+                && header.wdl_offset + (entries + 3) / 4 <= header.dtm_offset
+                && header.dtm_offset + header.dtm_size <= t.size
+                && check_dtm(t.base + header.dtm_offset, header.dtm_size, entries)) {
+                t.wdl = t.base + header.wdl_offset;
+                t.dtm = t.base + header.dtm_offset;
+                t.failed = false;
+            }
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    t.ready.store(true, std::memory_order_release);
+    return !t.failed;
+}
+
+// Table and index of a position, false if there is none. Bare kings have no table and return true with a
+// null table.
+bool locate(const thc::ChessRules& cr, Table*& table, uint64_t& index) {
+    Material material;
+    Placement placement;
+    table = nullptr;
+    if (largest == 0 || !placement_of(cr, material, placement)) {
+        return false;
+    }
+    if (material.count() == 2) {
+        return true;
+    }
+    auto it = tables.find(material.name());
+    if (it == tables.end() || !map_file(*it->second)) {
+        return false;
+    }
+    table = it->second.get();
+    index = encode(material, placement);
+    return true;
+}
+
+// WDL code of an index, bare kings (no table) are a draw
+int wdl_code(const Table* table, uint64_t index) {
+    return table ? (table->wdl[index / 4] >> (index % 4 * 2)) & 3 : WDL_DRAW;
+}
+
+// Value (see index.h) of a position the tables store. Without dtm only the WDL section is read and a win
+// or loss comes back as the shortest one.
+bool stored_value(const thc::ChessRules& cr, bool dtm, uint8_t& value) {
+    Table* table;
+    uint64_t index;
+    if (!locate(cr, table, index)) return false;
+
+    int code = wdl_code(table, index);
+    if (code == WDL_ILLEGAL) return false;
+    if (dtm && table) {
+        value = read_dtm(table->dtm, index);
+    } else {
+        value = code == WDL_WIN ? 2 : code == WDL_LOSS ? 1 : VALUE_DRAW;
+    }
+    return true;
+}
+
+// Order of values for the side to move: faster wins first, slower losses before faster ones
+int value_rank(uint8_t value) {
+    constexpr int MAX_RANK = 1 << 16;
+    return is_win(value) ? MAX_RANK - mate_plies(value) : is_loss(value) ? -MAX_RANK + mate_plies(value) : 0;
+}
+
+// Value of any position without castling rights. The tables leave out en passant rights, the side to move
+// then gets the better of its en passant captures and the same position without the right (unless the
+// captures are its only moves).
+bool position_value(const thc::ChessRules& cr, bool dtm, uint8_t& value) {
+    if (cr.groomed_enpassant_target() == thc::SQUARE_INVALID) {
+        return stored_value(cr, dtm, value);
+    }
+
+    thc::ChessRules board = cr;
+    std::vector<thc::Move> moves;
+    board.GenLegalMoveList(moves);
+    bool other_moves = false, captures = false;
+    for (thc::Move& move : moves) {
+        if (move.special != thc::SPECIAL_WEN_PASSANT && move.special != thc::SPECIAL_BEN_PASSANT) {
+            other_moves = true;
+            continue;
+        }
+        uint8_t after;
+        board.PushMove(move);
+        bool found = stored_value(board, dtm, after);
+        board.PopMove(move);
+        if (!found) return false;
+
+        // The opponent's result one ply later
+        uint8_t v = is_decisive(after) ? uint8_t(after + 1) : VALUE_DRAW;
+        if (!captures || value_rank(v) > value_rank(value)) {
+            value = v;
+        }
+        captures = true;
+    }
+
+    if (captures && !other_moves) {
+        return true;
+    }
+    board.enpassant_target = thc::SQUARE_INVALID;
+    uint8_t without;
+    if (!stored_value(board, dtm, without)) return false;
+    if (!captures || value_rank(without) > value_rank(value)) {
+        value = without;
+    }
+    return true;
+}
+
+} // namespace
+
+int init(const std::string& path) {
+    release_tables();
+
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find(':', start);
+        if (end == std::string::npos) end = path.size();
+        std::string directory = path.substr(start, end - start);
+        start = end + 1;
+        if (directory.empty()) continue;
+
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) continue;
+        size_t suffix = std::strlen(FILE_SUFFIX);
+        while (dirent* ent = readdir(dir)) {
+            std::string file = ent->d_name;
+            Material material;
+            if (file.size() <= suffix || file.compare(file.size() - suffix, suffix, FILE_SUFFIX) != 0
+                || !Material::parse(file.substr(0, file.size() - suffix), material)
+                || !material.is_canonical() || tables.count(material.name())) {
+                continue;
+            }
+            auto table = std::make_unique<Table>();
+            table->path = directory + "/" + file;
+            table->material = material;
+            largest = std::max(largest, material.count());
+            tables[material.name()] = std::move(table);
+        }
+        closedir(dir);
+    }
+    return largest;
+}
+
+int max_pieces() {
+    return largest;
+}
+
+bool probe_wdl(const thc::ChessRules& cr, WDL& wdl) {
+    probe_stats.probes++;
+    uint8_t v;
+    if (!position_value(cr, false, v)) return false;
+
+    wdl = is_win(v) ? WIN : is_loss(v) ? LOSS : DRAW;
+    probe_stats.hits++;
+    return true;
+}
+
+bool probe_dtm(const thc::ChessRules& cr, WDL& wdl, int& plies) {
+    probe_stats.probes++;
+    uint8_t v;
+    if (!position_value(cr, true, v)) return false;
+
+    wdl = is_win(v) ? WIN : is_loss(v) ? LOSS : DRAW;
+    plies = is_decisive(v) ? mate_plies(v) : 0;
+    probe_stats.hits++;
+    return true;
+}
+
+bool filter_root_moves(thc::ChessRules& cr, std::vector<thc::Move>& moves) {
+    if (moves.empty()) return false;
+    std::vector<int> ranks;
+    for (thc::Move& move : moves) {
+        uint8_t v;
+        cr.PushMove(move);
+        bool found = position_value(cr, true, v);
+        cr.PopMove(move);
+        if (!found) return false;
+
+        // The opponent's loss in n plies is a win in n + 1 for us: faster wins first, slower losses first
+        ranks.push_back(-value_rank(v));
+    }
+
+    int best = *std::max_element(ranks.begin(), ranks.end());
+    std::vector<thc::Move> kept;
+    for (size_t i = 0; i < moves.size(); i++) {
+        if (ranks[i] == best) kept.push_back(moves[i]);
+    }
+    moves.swap(kept);
+    return true;
+}
+
+Stats& stats() {
+    return probe_stats;
+}
+
+} // namespace egtb
@@ -0,0 +1,54 @@
+#ifndef EGTB_H
+#define EGTB_H
+
+#include "thc.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ *  egtb
+ *
+ *  Probing of the engine's own distance to mate tables (.egtb files written by tbgen, see generator.h). Like
+ *  syzygy, init only scans the directories and a file is mapped read-only the first time its material is
+ *  probed. The WDL section is 2 bits per position for the search, the DTM section is compressed in blocks
+ *  and read at the root.
+ *
+ *  Distances are plain distance to mate and ignore the 50 move rule. Positions with castling rights are not
+ *  covered. An en passant right isn't stored, the probe resolves it from the captures and the position
+ *  without the right.
+ */
+
+namespace egtb {
+
+// From the side to move's point of view
+enum WDL { LOSS = -1, DRAW = 0, WIN = 1 };
+
+// Register the tables in path (directories separated by ':'), returns the largest piece count found.
+// Calling it again replaces the previous set of tables.
+int init(const std::string& path);
+
+// Largest piece count (kings included) with a table, 0 without tables
+int max_pieces();
+
+// Result for the side to move, false when no table covers the position
+bool probe_wdl(const thc::ChessRules& cr, WDL& wdl);
+
+// Result and distance to mate in plies (0 for draws and when mated)
+bool probe_dtm(const thc::ChessRules& cr, WDL& wdl, int& plies);
+
+// Keep only the root moves with the best result, the fastest mate when winning and the slowest when
+// losing. Returns false (moves untouched) if some position could not be probed.
+bool filter_root_moves(thc::ChessRules& cr, std::vector<thc::Move>& moves);
+
+// Probe counters of the calling thread since its last reset
+struct Stats {
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+};
+
+Stats& stats();
+
+} // namespace egtb
+
+#endif // EGTB_H
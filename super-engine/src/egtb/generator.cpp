@@ -0,0 +1,732 @@
+#include "generator.h"
+#include "index.h"
+#include "bitboard.h"
+#include "search-trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+
+namespace egtb {
+
+namespace {
+
+constexpr const char* PROMOTIONS = "QRBN";
+
+// Run body(begin, end, thread) over [0, count) in blocks handed out to the workers as they become free
+template <typename Body>
+void parallel_for(uint64_t count, int threads, Body body) {
+    constexpr uint64_t BLOCK = 1 << 14;
+    std::atomic<uint64_t> next {0};
+    auto worker = [&](int thread) {
+        SEARCH_TRACE_THREAD_NAME("generator");
+        for (uint64_t begin = next.fetch_add(BLOCK); begin < count; begin = next.fetch_add(BLOCK)) {
+            SEARCH_TRACE_SCOPE("block", "index", int64_t(begin));
+            body(begin, std::min(count, begin + BLOCK), thread);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) {
+        pool.emplace_back(worker, t);
+    }
+    worker(0);
+    SEARCH_TRACE_SCOPE("wait for workers");
+    for (std::thread& t : pool) {
+        t.join();
+    }
+}
+
+// A position being worked on: squares and piece types by material slot, ' ' for a captured piece. ep_slot
+// is the pawn that just moved two squares when the side to move can take it en passant, -1 otherwise.
+struct Board {
+    uint8_t squares[MAX_PIECES];
+    char type[MAX_PIECES];
+    bool black_to_move;
+    int8_t ep_slot;
+};
+
+Bitboard piece_attacks(char type, int sq, bool white, Bitboard occupied) {
+    switch (type) {
+    case 'P': return pawn_attacks(square_bb(sq), white);
+    case 'N': return knight_attacks(sq);
+    case 'B': return bishop_attacks(sq, occupied);
+    case 'R': return rook_attacks(sq, occupied);
+    case 'Q': return queen_attacks(sq, occupied);
+    default:  return king_attacks(sq);
+    }
+}
+
+// Material to a smaller table after a capture and/or promotion, with where each slot goes there (-1 for
+// the captured piece) and whether the child table has the colors swapped
+struct Transition {
+    Material child;
+    bool swap = false;
+    int8_t slot_map[MAX_PIECES];
+    const std::vector<uint8_t>* values = nullptr;   // Null for bare kings
+};
+
+class Generator;
+
+// Move generation and table lookups for one material set
+class Layout {
+public:
+    Layout(const Material& m) : material(m), n(m.count()) {
+        for (int i = 0; i < n; i++) {
+            white[i] = i < m.black_king_slot;
+        }
+    }
+
+    Board board(const Placement& p) const {
+        Board b;
+        for (int i = 0; i < n; i++) {
+            b.squares[i] = p.squares[i];
+            b.type[i] = char(std::toupper(material.pieces[i]));
+        }
+        b.black_to_move = p.black_to_move;
+        b.ep_slot = -1;
+        return b;
+    }
+
+    // Positions of the analysis: the table's indices, then the en passant positions
+    uint64_t nodes() const { return material.size() + en_passant.size(); }
+
+    Board node(uint64_t idx) const {
+        if (idx < material.size()) {
+            return board(decode(material, idx));
+        }
+        uint64_t key = en_passant[idx - material.size()];
+        Board b = board(decode(material, key / 8));
+        int sq = (b.black_to_move ? 32 : 24) + int(key % 8);
+        for (int i = 0; i < n; i++) {
+            if (b.type[i] == 'P' && b.squares[i] == sq) {
+                b.ep_slot = int8_t(i);
+            }
+        }
+        return b;
+    }
+
+    uint64_t index(const Board& b) const {
+        Placement p;
+        std::memcpy(p.squares, b.squares, sizeof(p.squares));
+        p.black_to_move = b.black_to_move;
+        uint64_t idx = encode(material, p);
+        if (b.ep_slot < 0) {
+            return idx;
+        }
+        // Keyed by the file in the table's orientation (encode mirrors the White king to files a-d). Only
+        // legal positions were listed, an illegal one keeps its own (illegal) index.
+        uint64_t key = idx * 8 + (b.squares[b.ep_slot] % 8 ^ (b.squares[0] % 8 > 3 ? 7 : 0));
+        auto it = std::lower_bound(en_passant.begin(), en_passant.end(), key);
+        return it != en_passant.end() && *it == key ? material.size() + (it - en_passant.begin()) : idx;
+    }
+
+    Bitboard occupied(const Board& b, int color = -1) const {
+        Bitboard occ = 0;
+        for (int i = 0; i < n; i++) {
+            if (b.type[i] != ' ' && (color < 0 || white[i] == bool(color))) {
+                occ |= square_bb(b.squares[i]);
+            }
+        }
+        return occ;
+    }
+
+    bool king_attacked(const Board& b, bool white_king) const {
+        int king = b.squares[white_king ? 0 : material.black_king_slot];
+        Bitboard occ = occupied(b);
+        for (int i = 0; i < n; i++) {
+            if (b.type[i] != ' ' && white[i] != white_king
+                && (piece_attacks(b.type[i], b.squares[i], white[i], occ) & square_bb(king))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Whether the pawn in slot can have just moved two squares (it stands where a double push ends, the
+    // squares it passed are empty) and the side to move can take it en passant
+    bool en_passant_node(const Board& b, int slot) const {
+        int sq = b.squares[slot];
+        if (b.type[slot] != 'P' || white[slot] != b.black_to_move || sq / 8 != (white[slot] ? 4 : 3)) {
+            return false;
+        }
+        int back = white[slot] ? 8 : -8;
+        Bitboard occ = occupied(b);
+        if (occ & (square_bb(sq + back) | square_bb(sq + 2 * back))) {
+            return false;
+        }
+        bool found = false;
+        for_each_en_passant(b, slot, [&](const Board&) { found = true; });
+        return found;
+    }
+
+    // visit(board after the capture) for each legal en passant capture of the pawn in slot
+    template <typename Visit>
+    void for_each_en_passant(const Board& b, int slot, Visit visit) const {
+        bool us = !b.black_to_move;
+        int sq = b.squares[slot];
+        for (int i = 0; i < n; i++) {
+            if (b.type[i] == 'P' && white[i] == us && b.squares[i] / 8 == sq / 8
+                && std::abs(b.squares[i] % 8 - sq % 8) == 1) {
+                Board after = b;
+                after.type[slot] = ' ';
+                after.squares[i] = uint8_t(sq + (us ? -8 : 8));
+                after.black_to_move = !b.black_to_move;
+                after.ep_slot = -1;
+                if (!king_attacked(after, us)) {
+                    visit(after);
+                }
+            }
+        }
+    }
+
+    // Pieces on distinct squares, pawns off the back ranks and the side that just moved not in check
+    bool legal(const Board& b) const {
+        Bitboard occ = 0;
+        for (int i = 0; i < n; i++) {
+            int sq = b.squares[i];
+            if ((occ & square_bb(sq)) || (b.type[i] == 'P' && (sq / 8 == 0 || sq / 8 == 7))) {
+                return false;
+            }
+            occ |= square_bb(sq);
+        }
+        return !king_attacked(b, b.black_to_move);
+    }
+
+    // visit(board after the move, captured slot or -1, promoted slot or -1) for each legal move
+    template <typename Visit>
+    void for_each_move(const Board& b, Visit visit) const {
+        bool us = !b.black_to_move;
+        Bitboard occ = occupied(b);
+        Bitboard own = occupied(b, us);
+
+        auto emit = [&](int slot, int to, char promotion) {
+            Board after = b;
+            after.ep_slot = -1;
+            int captured = -1;
+            for (int i = 0; i < n; i++) {
+                if (after.type[i] != ' ' && after.squares[i] == to) {
+                    captured = i;
+                    after.type[i] = ' ';
+                }
+            }
+            after.squares[slot] = uint8_t(to);
+            if (promotion) {
+                after.type[slot] = promotion;
+            }
+            after.black_to_move = !b.black_to_move;
+            if (!king_attacked(after, us)) {
+                // A double push the opponent can take en passant leads to the en passant position
+                if (has_en_passant && std::abs(to - b.squares[slot]) == 16 && en_passant_node(after, slot)) {
+                    after.ep_slot = int8_t(slot);
+                }
+                visit(after, captured, promotion ? slot : -1);
+            }
+        };
+        auto emit_pawn = [&](int slot, int to) {
+            if (to / 8 == 0 || to / 8 == 7) {
+                for (const char* p = PROMOTIONS; *p; p++) {
+                    emit(slot, to, *p);
+                }
+            } else {
+                emit(slot, to, 0);
+            }
+        };
+
+        for (int i = 0; i < n; i++) {
+            if (b.type[i] == ' ' || white[i] != us) {
+                continue;
+            }
+            int sq = b.squares[i];
+            if (b.type[i] == 'P') {
+                int step = us ? -8 : 8;
+                if (!(occ & square_bb(sq + step))) {
+                    emit_pawn(i, sq + step);
+                    if (sq / 8 == (us ? 6 : 1) && !(occ & square_bb(sq + 2 * step))) {
+                        emit(i, sq + 2 * step, 0);
+                    }
+                }
+                for (Bitboard t = pawn_attacks(square_bb(sq), us) & occ & ~own; t; ) {
+                    emit_pawn(i, pop_lsb(t));
+                }
+            } else {
+                for (Bitboard t = piece_attacks(b.type[i], sq, us, occ) & ~own; t; ) {
+                    emit(i, pop_lsb(t), 0);
+                }
+            }
+        }
+        if (b.ep_slot >= 0) {
+            for_each_en_passant(b, b.ep_slot, [&](const Board& after) { visit(after, b.ep_slot, -1); });
+        }
+    }
+
+    // visit(predecessor) for each quiet move by the side that just moved that leads to b. Kings are kept
+    // apart, the index has no room for them side by side; other legality of the predecessor is left to
+    // the caller (its table entry).
+    //
+    // An en passant position is only reached by its double push. A double push the opponent can take en
+    // passant leads to that position rather than to b, and every predecessor also comes in the variants
+    // where a pawn of the other side just moved two squares, which have the same moves plus the capture.
+    template <typename Visit>
+    void for_each_unmove(const Board& b, Visit visit) const {
+        bool them = b.black_to_move;
+        Bitboard occ = occupied(b);
+
+        auto emit = [&](int slot, int from) {
+            Board before = b;
+            before.squares[slot] = uint8_t(from);
+            before.black_to_move = !b.black_to_move;
+            before.ep_slot = -1;
+            visit(before);
+            if (has_en_passant) {
+                for (int j = 0; j < n; j++) {
+                    if (en_passant_node(before, j)) {
+                        before.ep_slot = int8_t(j);
+                        visit(before);
+                        before.ep_slot = -1;
+                    }
+                }
+            }
+        };
+
+        if (b.ep_slot >= 0) {
+            emit(b.ep_slot, b.squares[b.ep_slot] + (them ? 16 : -16));
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (white[i] != them) {
+                continue;
+            }
+            int sq = b.squares[i];
+            if (b.type[i] == 'P') {
+                int back = them ? 8 : -8;
+                int row = (them ? sq / 8 : 7 - sq / 8);
+                if (row <= 5 && !(occ & square_bb(sq + back))) {
+                    emit(i, sq + back);
+                    if (row == 4 && !(occ & square_bb(sq + 2 * back)) && !(has_en_passant && en_passant_node(b, i))) {
+                        emit(i, sq + 2 * back);
+                    }
+                }
+            } else {
+                Bitboard apart = 0;
+                if (i == 0 || i == material.black_king_slot) {
+                    apart = king_attacks(b.squares[i == 0 ? material.black_king_slot : 0]);
+                }
+                for (Bitboard f = piece_attacks(b.type[i], sq, them, occ) & ~occ & ~apart; f; ) {
+                    emit(i, pop_lsb(f));
+                }
+            }
+        }
+    }
+
+    // Transitions by (captured slot + 1, promoted slot + 1, promotion piece)
+    static int transition_key(int captured, int promoted, char promotion) {
+        int piece = promoted < 0 ? 0 : int(std::strchr(PROMOTIONS, promotion) - PROMOTIONS) + 1;
+        return ((captured + 1) * (MAX_PIECES + 1) + promoted + 1) * 5 + piece;
+    }
+
+    // Value of a position in a smaller table, from its side to move's point of view
+    uint8_t child_value(const Board& after, int captured, int promoted) const {
+        const Transition& t = transitions.at(
+            transition_key(captured, promoted, promoted < 0 ? 0 : after.type[promoted]));
+        if (!t.values) {
+            return VALUE_DRAW;
+        }
+        Placement p;
+        for (int i = 0; i < n; i++) {
+            if (t.slot_map[i] >= 0) {
+                p.squares[t.slot_map[i]] = uint8_t(after.squares[i] ^ (t.swap ? 56 : 0));
+            }
+        }
+        p.black_to_move = after.black_to_move != t.swap;
+        return (*t.values)[encode(t.child, p)];
+    }
+
+    const Material material;
+    const int n;
+    bool white[MAX_PIECES];
+    std::map<int, Transition> transitions;
+
+    // Positions right after a double push that the side to move can take en passant, as table index * 8 +
+    // file, sorted. They aren't stored in the table but are analysed as indices size() + i, so a double
+    // push gets the value of the capture where that is better. Only with pawns on both sides.
+    bool has_en_passant = false;
+    std::vector<uint64_t> en_passant;
+};
+
+class Generator {
+public:
+    explicit Generator(const GeneratorOptions& options) : options(options) {
+        threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Values of a canonical material set, loaded or generated, null on failure
+    const std::vector<uint8_t>* table(const Material& m) {
+        std::string name = m.name();
+        auto it = tables.find(name);
+        if (it != tables.end()) {
+            return it->second.get();
+        }
+
+        auto values = std::make_unique<std::vector<uint8_t>>();
+        if (!load(m, *values)) {
+            Layout layout(m);
+            if (!prepare(layout) || !build(layout, *values) || !save(m, *values)) {
+                return nullptr;
+            }
+        }
+        return (tables[name] = std::move(values)).get();
+    }
+
+    void message(const std::string& text) {
+        if (options.log) {
+            *options.log << text << std::endl;
+        }
+    }
+
+private:
+    std::string path(const Material& m) const {
+        return options.directory + "/" + m.name() + FILE_SUFFIX;
+    }
+
+    // Make every table a capture or promotion leads to and record how slots map into it
+    bool prepare(Layout& layout) {
+        const Material& m = layout.material;
+        int n = layout.n;
+        for (int captured = -1; captured < n; captured++) {
+            for (int promoted = -1; promoted < n; promoted++) {
+                bool pawn = promoted >= 0 && m.pieces[promoted] == (layout.white[promoted] ? 'P' : 'p');
+                if ((captured < 0 && promoted < 0) || captured == 0 || captured == m.black_king_slot
+                    || (promoted >= 0 && !pawn) || captured == promoted
+                    || (captured >= 0 && promoted >= 0 && layout.white[captured] == layout.white[promoted])) {
+                    continue;
+                }
+                for (int piece = promoted < 0 ? 0 : 1; piece <= (promoted < 0 ? 0 : 4); piece++) {
+                    std::string white, black;
+                    std::vector<char> pieces;
+                    for (int i = 0; i < n; i++) {
+                        char c = i == promoted ? PROMOTIONS[piece - 1] : char(std::toupper(m.pieces[i]));
+                        pieces.push_back(i == captured ? ' ' : layout.white[i] ? c : char(std::tolower(c)));
+                        if (i != captured && i != 0 && i != m.black_king_slot) {
+                            (layout.white[i] ? white : black) += c;
+                        }
+                    }
+
+                    Transition t;
+                    Material::parse("K" + white + "vK" + black, t.child);
+                    t.swap = !t.child.is_canonical();
+                    if (t.swap) {
+                        t.child = t.child.swapped();
+                    }
+                    std::vector<char> slots = t.child.pieces;
+                    for (int i = 0; i < n; i++) {
+                        char c = pieces[i];
+                        if (t.swap && c != ' ') {
+                            c = char(std::isupper(c) ? std::tolower(c) : std::toupper(c));
+                        }
+                        auto slot = c == ' ' ? slots.end() : std::find(slots.begin(), slots.end(), c);
+                        t.slot_map[i] = int8_t(slot == slots.end() ? -1 : slot - slots.begin());
+                        if (slot != slots.end()) {
+                            *slot = ' ';
+                        }
+                    }
+                    if (t.child.count() > 2 && !(t.values = table(t.child))) {
+                        return false;
+                    }
+
+                    char promotion = piece ? PROMOTIONS[piece - 1] : 0;
+                    layout.transitions[Layout::transition_key(captured, promoted, promotion)] = t;
+                }
+            }
+        }
+
+        if (m.pawns_on_both_sides()) {
+            find_en_passant(layout);
+        }
+        return true;
+    }
+
+    // List the positions that follow a double push the opponent can take en passant (Layout::en_passant)
+    void find_en_passant(Layout& layout) {
+        const Material& m = layout.material;
+        std::vector<std::vector<uint64_t>> found(threads);
+        layout.has_en_passant = true;
+        parallel_for(m.size(), threads, [&](uint64_t begin, uint64_t end, int thread) {
+            for (uint64_t idx = begin; idx < end; idx++) {
+                Board b = layout.board(decode(m, idx));
+                if (!layout.legal(b)) {
+                    continue;
+                }
+                for (int i = 0; i < layout.n; i++) {
+                    if (layout.en_passant_node(b, i)) {
+                        found[thread].push_back(idx * 8 + b.squares[i] % 8);
+                    }
+                }
+            }
+        });
+        for (const std::vector<uint64_t>& f : found) {
+            layout.en_passant.insert(layout.en_passant.end(), f.begin(), f.end());
+        }
+        std::sort(layout.en_passant.begin(), layout.en_passant.end());
+    }
+
+    bool build(const Layout& layout, std::vector<uint8_t>& values) {
+        auto start = std::chrono::steady_clock::now();
+        const uint64_t size = layout.nodes();
+
+        // value: VALUE_DRAW while undecided. remaining: moves not yet known to lose (a win for the
+        // opponent). deepest: longest of those wins. scheduled: ply at which a capture or promotion
+        // decides the position, a win unless every move is resolved.
+        std::vector<std::atomic<uint8_t>> value(size);
+        std::vector<std::atomic<uint8_t>> remaining(size);
+        std::vector<std::atomic<uint8_t>> deepest(size);
+        std::vector<uint8_t> scheduled(size);
+        std::vector<std::atomic<uint64_t>> scheduled_at(MAX_MATE_PLIES + 2);
+        std::atomic<bool> overflow {false};
+        std::vector<std::vector<uint64_t>> found(threads);
+
+        auto schedule = [&](uint64_t idx, int plies) {
+            if (plies > MAX_MATE_PLIES) {
+                overflow = true;
+                return;
+            }
+            scheduled[idx] = uint8_t(plies);
+            scheduled_at[plies]++;
+        };
+
+        parallel_for(size, threads, [&](uint64_t begin, uint64_t end, int thread) {
+            for (uint64_t idx = begin; idx < end; idx++) {
+                Board b = layout.node(idx);
+                if (b.ep_slot < 0 && !layout.legal(b)) {
+                    value[idx] = VALUE_ILLEGAL;
+                    continue;
+                }
+
+                int moves = 0, resolved = 0, longest = 0, best_win = MAX_MATE_PLIES + 1;
+                layout.for_each_move(b, [&](const Board& after, int captured, int promoted) {
+                    moves++;
+                    if (captured < 0 && promoted < 0) {
+                        return;
+                    }
+                    uint8_t v = layout.child_value(after, captured, promoted);
+                    if (is_loss(v)) {
+                        best_win = std::min(best_win, mate_plies(v) + 1);
+                    } else if (is_win(v)) {
+                        resolved++;
+                        longest = std::max(longest, mate_plies(v));
+                    }
+                });
+
+                remaining[idx] = uint8_t(moves - resolved);
+                deepest[idx] = uint8_t(longest);
+                if (moves == 0) {
+                    if (layout.king_attacked(b, !b.black_to_move)) {
+                        value[idx] = 1;
+                        found[thread].push_back(idx);
+                    }
+                } else if (moves == resolved) {
+                    schedule(idx, longest + 1);
+                } else if (best_win <= MAX_MATE_PLIES) {
+                    schedule(idx, best_win);
+                }
+            }
+        });
+
+        std::vector<uint64_t> frontier;
+        int plies = 0;
+        for (;;) {
+            for (std::vector<uint64_t>& f : found) {
+                frontier.insert(frontier.end(), f.begin(), f.end());
+                f.clear();
+            }
+            bool later = false;
+            for (int p = plies + 1; p <= MAX_MATE_PLIES; p++) {
+                later |= scheduled_at[p] > 0;
+            }
+            if ((frontier.empty() && !later) || overflow) {
+                break;
+            }
+            if (++plies > MAX_MATE_PLIES) {
+                overflow = true;
+                break;
+            }
+            SEARCH_TRACE_SCOPE("retrograde ply", "plies", plies);
+
+            auto decide = [&](uint64_t idx, int thread) {
+                uint8_t expected = VALUE_DRAW;
+                if (value[idx].compare_exchange_strong(expected, uint8_t(plies + 1))) {
+                    found[thread].push_back(idx);
+                }
+            };
+
+            if (scheduled_at[plies] > 0) {
+                parallel_for(size, threads, [&](uint64_t begin, uint64_t end, int thread) {
+                    for (uint64_t idx = begin; idx < end; idx++) {
+                        if (scheduled[idx] == plies) {
+                            decide(idx, thread);
+                        }
+                    }
+                });
+            }
+
+            parallel_for(frontier.size(), threads, [&](uint64_t begin, uint64_t end, int thread) {
+                for (uint64_t i = begin; i < end; i++) {
+                    bool lost = is_loss(value[frontier[i]]);
+                    layout.for_each_unmove(layout.node(frontier[i]), [&](const Board& pred) {
+                        uint64_t idx = layout.index(pred);
+                        if (value[idx] != VALUE_DRAW) {
+                            return;
+                        }
+                        if (lost) {
+                            decide(idx, thread);
+                            return;
+                        }
+                        uint8_t d = deepest[idx];
+                        while (d < plies - 1 && !deepest[idx].compare_exchange_weak(d, uint8_t(plies - 1))) {
+                        }
+                        if (remaining[idx].fetch_sub(1) == 1) {
+                            int loss = std::max<int>(deepest[idx], plies - 1) + 1;
+                            if (loss == plies) {
+                                decide(idx, thread);
+                            } else {
+                                schedule(idx, loss);
+                            }
+                        }
+                    });
+                }
+            });
+            frontier.clear();
+        }
+
+        if (overflow) {
+            message(layout.material.name() + ": mate longer than " + std::to_string(MAX_MATE_PLIES) + " plies");
+            return false;
+        }
+
+        // The en passant positions were only needed for the analysis
+        values.resize(layout.material.size());
+        uint64_t wins = 0, losses = 0;
+        int longest = 0;
+        for (uint64_t idx = 0; idx < values.size(); idx++) {
+            values[idx] = value[idx];
+            wins += is_win(values[idx]);
+            losses += is_loss(values[idx]);
+            longest = is_decisive(values[idx]) ? std::max(longest, mate_plies(values[idx])) : longest;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        message(layout.material.name() + ": " + std::to_string(values.size()) + " positions, " + std::to_string(wins)
+                + " wins, " + std::to_string(losses) + " losses, longest mate " + std::to_string(longest)
+                + " plies, " + std::to_string(seconds) + "s on " + std::to_string(threads) + " threads");
+        return true;
+    }
+
+    bool load(const Material& m, std::vector<uint8_t>& values) {
+        std::ifstream in(path(m), std::ios::binary);
+        FileHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "418E", 4)
+            || header.version != FILE_VERSION || header.entries != m.size() || m.name() != header.material) {
+            return false;
+        }
+        std::vector<uint8_t> wdl((header.entries + 3) / 4);
+        std::vector<uint8_t> dtm(header.dtm_size);
+        in.seekg(header.wdl_offset);
+        in.read(reinterpret_cast<char*>(wdl.data()), wdl.size());
+        in.seekg(header.dtm_offset);
+        if (!in.read(reinterpret_cast<char*>(dtm.data()), dtm.size()) || !check_dtm(dtm.data(), dtm.size(), header.entries)) {
+            return false;
+        }
+        values.resize(header.entries);
+        for (uint64_t idx = 0; idx < values.size(); idx++) {
+            bool illegal = (wdl[idx / 4] >> (idx % 4 * 2) & 3) == WDL_ILLEGAL;
+            values[idx] = illegal ? VALUE_ILLEGAL : read_dtm(dtm.data(), idx);
+        }
+        return true;
+    }
+
+    bool save(const Material& m, const std::vector<uint8_t>& values) {
+        auto align = [](uint64_t offset) { return (offset + 63) & ~uint64_t(63); };
+
+        FileHeader header {};
+        std::memcpy(header.magic, "418E", 4);
+        header.version = FILE_VERSION;
+        header.entries = values.size();
+        header.wdl_offset = sizeof(FileHeader);
+        header.dtm_offset = align(header.wdl_offset + (values.size() + 3) / 4);
+        std::strncpy(header.material, m.name().c_str(), sizeof(header.material) - 1);
+
+        std::vector<uint8_t> wdl(header.dtm_offset - header.wdl_offset);
+        for (uint64_t idx = 0; idx < values.size(); idx++) {
+            uint8_t v = values[idx];
+            int code = v == VALUE_ILLEGAL ? WDL_ILLEGAL : is_win(v) ? WDL_WIN : is_loss(v) ? WDL_LOSS : WDL_DRAW;
+            wdl[idx / 4] |= uint8_t(code << (idx % 4 * 2));
+        }
+        std::vector<uint8_t> dtm = compress_dtm(values);
+        header.dtm_size = dtm.size();
+
+        std::ofstream out(path(m), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(wdl.data()), wdl.size());
+        out.write(reinterpret_cast<const char*>(dtm.data()), dtm.size());
+        if (!out) {
+            message("cannot write " + path(m));
+            return false;
+        }
+        return true;
+    }
+
+    const GeneratorOptions& options;
+    int threads;
+    std::map<std::string, std::unique_ptr<std::vector<uint8_t>>> tables;
+};
+
+} // namespace
+
+bool generate(const std::string& material, const GeneratorOptions& options) {
+    Generator generator(options);
+    Material m;
+    if (!Material::parse(material, m) || m.count() < MIN_PIECES) {
+        generator.message("bad material " + material);
+        return false;
+    }
+    if (!m.is_canonical()) {
+        m = m.swapped();
+    }
+    return generator.table(m) != nullptr;
+}
+
+std::vector<std::string> all_materials(int pieces) {
+    // Multisets of non-king pieces up to a given size, as strings in QRBNP order
+    const std::string order = "QRBNP";
+    std::vector<std::string> sets {""};
+    for (size_t i = 0; i < sets.size(); i++) {
+        if (int(sets[i].size()) + 2 >= pieces) {
+            continue;
+        }
+        for (size_t p = sets[i].empty() ? 0 : order.find(sets[i].back()); p < order.size(); p++) {
+            sets.push_back(sets[i] + order[p]);
+        }
+    }
+
+    std::vector<std::string> names;
+    for (int count = MIN_PIECES; count <= pieces; count++) {
+        for (const std::string& white : sets) {
+            for (const std::string& black : sets) {
+                Material m;
+                if (int(white.size() + black.size()) + 2 == count && Material::parse("K" + white + "vK" + black, m)
+                    && m.is_canonical()) {
+                    names.push_back(m.name());
+                }
+            }
+        }
+    }
+    return names;
+}
+
+} // namespace egtb
@@ -0,0 +1,45 @@
+#ifndef EGTB_GENERATOR_H
+#define EGTB_GENERATOR_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ *  egtb generator
+ *
+ *  Builds distance to mate tables by retrograde analysis. Every index is decoded once to count its legal
+ *  moves and find mates, stalemates and the results of captures and promotions (looked up in the smaller
+ *  tables, which are generated first). After that, pass n takes the positions decided in pass n-1 and
+ *  walks their un-moves: a predecessor of a loss is a win in n plies, a predecessor whose last unresolved
+ *  move led to a win is a loss. Whatever is left undecided at the end is a draw.
+ *
+ *  Both phases are split over worker threads. Passes are separated by joins and the per-position state
+ *  is atomic, so the result doesn't depend on the thread count.
+ *
+ *  Positions with castling rights or an en passant square are not part of the tables. With pawns on both
+ *  sides, the positions right after a double push that can be taken en passant are analysed as extra
+ *  nodes behind the table indices and dropped when the table is written; the prober recovers their value
+ *  from the captures and the stored position.
+ */
+
+namespace egtb {
+
+struct GeneratorOptions {
+    std::string directory = ".";    // Where tables are read from and written to
+    int threads = 0;                // 0 for one per hardware thread
+    std::ostream* log = nullptr;    // Progress lines, one per table
+};
+
+// Generate the table for a material set ("KRvK") and, first, every table it converts into. Tables already
+// in the directory are loaded instead of generated. False (with a message on the log) on a malformed
+// name, an I/O error or a mate longer than the format can store.
+bool generate(const std::string& material, const GeneratorOptions& options);
+
+// Every material set with 3 to pieces pieces that generate() accepts, each once with the stronger side
+// as White, smaller tables first
+std::vector<std::string> all_materials(int pieces);
+
+} // namespace egtb
+
+#endif // EGTB_GENERATOR_H
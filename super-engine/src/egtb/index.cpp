@@ -0,0 +1,386 @@
+#include "index.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace egtb {
+
+namespace {
+
+constexpr const char* PIECE_ORDER = "QRBNP";
+
+int order_of(char piece) {
+    const char* p = std::strchr(PIECE_ORDER, std::toupper(piece));
+    return p ? int(p - PIECE_ORDER) : -1;
+}
+
+int king_square_of_slot(int slot, bool pawns) {
+    return (slot / 4 + (pawns ? 0 : 4)) * 8 + slot % 4;
+}
+
+// White king slot and Black king square of every king pair, and the pair of each
+struct KingPairs {
+    int16_t pair[32][64];
+    std::vector<uint8_t> white_slot, black_square;
+
+    explicit KingPairs(bool pawns) {
+        for (int slot = 0; slot < (pawns ? 32 : 16); slot++) {
+            int wk = king_square_of_slot(slot, pawns);
+            for (int bk = 0; bk < 64; bk++) {
+                bool apart = std::abs(wk % 8 - bk % 8) > 1 || std::abs(wk / 8 - bk / 8) > 1;
+                pair[slot][bk] = int16_t(apart ? white_slot.size() : -1);
+                if (apart) {
+                    white_slot.push_back(uint8_t(slot));
+                    black_square.push_back(uint8_t(bk));
+                }
+            }
+        }
+    }
+
+    uint64_t count() const { return white_slot.size(); }
+};
+
+const KingPairs& king_pairs(bool pawns) {
+    static const KingPairs with_pawns(true), without_pawns(false);
+    return pawns ? with_pawns : without_pawns;
+}
+
+// n choose k for n <= 64, 0 when k > n
+uint64_t binomial(int n, int k) {
+    static const auto table = [] {
+        std::array<std::array<uint64_t, MAX_PIECES + 1>, 65> t {};
+        for (int i = 0; i <= 64; i++) {
+            t[i][0] = 1;
+            for (int j = 1; j <= MAX_PIECES && j <= i; j++) {
+                t[i][j] = t[i - 1][j - 1] + t[i - 1][j];
+            }
+        }
+        return t;
+    }();
+    return table[n][k];
+}
+
+int popcount(uint64_t bits) {
+    return __builtin_popcountll(bits);
+}
+
+// The rank-th free square from first on (occupied squares are all first or later), as numbered by a
+// group's subset index
+int nth_free(uint64_t occupied, int rank, int first) {
+    int sq = first + rank;
+    for (; occupied && __builtin_ctzll(occupied) <= sq; occupied &= occupied - 1) {
+        sq++;
+    }
+    return sq;
+}
+
+// Bits per index in a DTM block with a palette of count values
+int palette_bits(unsigned count) {
+    int bits = 0;
+    while ((1u << bits) < count) {
+        bits++;
+    }
+    return bits;
+}
+
+// Counts of Q, R, B, N, P on one side, the side with the larger tuple is the stronger one
+std::array<int, 5> side_counts(const Material& m, bool white) {
+    std::array<int, 5> counts {};
+    int begin = white ? 1 : m.black_king_slot + 1;
+    int end = white ? m.black_king_slot : m.count();
+    for (int i = begin; i < end; i++) {
+        counts[order_of(m.pieces[i])]++;
+    }
+    return counts;
+}
+
+Material make_material(std::string white, std::string black) {
+    auto by_order = [](char a, char b) { return order_of(a) < order_of(b); };
+    std::sort(white.begin(), white.end(), by_order);
+    std::sort(black.begin(), black.end(), by_order);
+
+    Material m;
+    m.pieces.push_back('K');
+    for (char c : white) {
+        m.pieces.push_back(char(std::toupper(c)));
+    }
+    m.black_king_slot = m.count();
+    m.pieces.push_back('k');
+    for (char c : black) {
+        m.pieces.push_back(char(std::tolower(c)));
+    }
+    m.has_pawns = std::find_if(m.pieces.begin(), m.pieces.end(),
+                               [](char c) { return std::toupper(c) == 'P'; }) != m.pieces.end();
+
+    // Runs of identical pieces, all but the pawns first; each group's squares avoid the kings and the
+    // pieces before it, pawns only the pawns before them
+    int placed = 2, pawns_placed = 0;
+    for (bool pawns : {false, true}) {
+        for (int i = 1; i < m.count(); i++) {
+            char c = m.pieces[i];
+            if (i == m.black_king_slot || (std::toupper(c) == 'P') != pawns || m.pieces[i - 1] == c) {
+                continue;
+            }
+            PieceGroup g {i, 0, pawns, 0};
+            while (i + g.count < m.count() && m.pieces[i + g.count] == c) {
+                g.count++;
+            }
+            g.subsets = pawns ? binomial(48 - pawns_placed, g.count) : binomial(64 - placed, g.count);
+            (pawns ? pawns_placed : placed) += g.count;
+            m.groups.push_back(g);
+        }
+    }
+    return m;
+}
+
+} // namespace
+
+bool Material::parse(const std::string& name, Material& out) {
+    size_t v = name.find_first_of("vV");
+    if (v == std::string::npos || v == 0 || v + 1 >= name.size()) {
+        return false;
+    }
+    std::string white = name.substr(0, v);
+    std::string black = name.substr(v + 1);
+    if (std::toupper(white[0]) != 'K' || std::toupper(black[0]) != 'K'
+        || white.size() + black.size() > size_t(MAX_PIECES)) {
+        return false;
+    }
+    white.erase(0, 1);
+    black.erase(0, 1);
+    for (char c : white + black) {
+        if (order_of(c) < 0) {
+            return false;
+        }
+    }
+    out = make_material(white, black);
+    return true;
+}
+
+std::string Material::name() const {
+    std::string s;
+    for (int i = 0; i < count(); i++) {
+        if (i == black_king_slot) {
+            s += 'v';
+        }
+        s += char(std::toupper(pieces[i]));
+    }
+    return s;
+}
+
+uint64_t Material::size() const {
+    uint64_t n = 2 * king_pairs(has_pawns).count();
+    for (const PieceGroup& g : groups) {
+        n *= g.subsets;
+    }
+    return n;
+}
+
+Material Material::swapped() const {
+    std::string white(pieces.begin() + 1, pieces.begin() + black_king_slot);
+    std::string black(pieces.begin() + black_king_slot + 1, pieces.end());
+    return make_material(black, white);
+}
+
+bool Material::is_canonical() const {
+    return side_counts(*this, true) >= side_counts(*this, false);
+}
+
+bool Material::pawns_on_both_sides() const {
+    return std::count(pieces.begin(), pieces.end(), 'P') && std::count(pieces.begin(), pieces.end(), 'p');
+}
+
+uint64_t encode(const Material& m, Placement p) {
+    int n = m.count();
+    if (p.squares[0] % 8 > 3) {
+        for (int i = 0; i < n; i++) {
+            p.squares[i] ^= 7;
+        }
+    }
+    if (!m.has_pawns && p.squares[0] / 8 < 4) {
+        for (int i = 0; i < n; i++) {
+            p.squares[i] ^= 56;
+        }
+    }
+
+    const KingPairs& kings = king_pairs(m.has_pawns);
+    int row = p.squares[0] / 8 - (m.has_pawns ? 0 : 4);
+    int black_king = p.squares[m.black_king_slot];
+    uint64_t index = uint64_t(p.black_to_move) * kings.count() + kings.pair[row * 4 + p.squares[0] % 8][black_king];
+    uint64_t occupied = 1ULL << p.squares[0] | 1ULL << black_king;
+    uint64_t pawns = 0;
+    for (const PieceGroup& g : m.groups) {
+        uint8_t* squares = p.squares + g.first;
+        std::sort(squares, squares + g.count);
+        uint64_t subset = 0;
+        for (int k = 0; k < g.count; k++) {
+            uint64_t below = (1ULL << squares[k]) - 1;
+            int rank = g.pawns ? squares[k] - 8 - popcount(pawns & below) : squares[k] - popcount(occupied & below);
+            subset += binomial(rank, k + 1);
+        }
+        for (int k = 0; k < g.count; k++) {
+            (g.pawns ? pawns : occupied) |= 1ULL << squares[k];
+        }
+        index = index * g.subsets + subset;
+    }
+    return index;
+}
+
+Placement decode(const Material& m, uint64_t index) {
+    uint64_t subsets[MAX_PIECES];
+    for (int i = int(m.groups.size()) - 1; i >= 0; i--) {
+        subsets[i] = index % m.groups[i].subsets;
+        index /= m.groups[i].subsets;
+    }
+    const KingPairs& kings = king_pairs(m.has_pawns);
+    uint64_t pair = index % kings.count();
+
+    Placement p;
+    p.black_to_move = index / kings.count();
+    p.squares[0] = uint8_t(king_square_of_slot(kings.white_slot[pair], m.has_pawns));
+    p.squares[m.black_king_slot] = kings.black_square[pair];
+    uint64_t occupied = 1ULL << p.squares[0] | 1ULL << p.squares[m.black_king_slot];
+    uint64_t pawns = 0;
+    for (size_t i = 0; i < m.groups.size(); i++) {
+        const PieceGroup& g = m.groups[i];
+        uint64_t subset = subsets[i];
+        for (int k = g.count; k > 0; k--) {
+            int rank = k == 1 ? int(subset) : k - 1;
+            while (rank < 64 && binomial(rank + 1, k) <= subset) {
+                rank++;
+            }
+            subset -= binomial(rank, k);
+            p.squares[g.first + k - 1] = uint8_t(g.pawns ? nth_free(pawns, rank, 8) : nth_free(occupied, rank, 0));
+        }
+        for (int k = 0; k < g.count; k++) {
+            (g.pawns ? pawns : occupied) |= 1ULL << p.squares[g.first + k];
+        }
+    }
+    return p;
+}
+
+bool placement_of(const thc::ChessRules& cr, Material& material, Placement& placement) {
+    if (cr.wking || cr.wqueen || cr.bking || cr.bqueen || cr.groomed_enpassant_target() != thc::SQUARE_INVALID) {
+        return false;
+    }
+
+    std::string white, black;
+    int white_king = -1, black_king = -1;
+    for (int sq = 0; sq < 64; sq++) {
+        char c = cr.squares[sq];
+        if (c == 'K') {
+            white_king = sq;
+        } else if (c == 'k') {
+            black_king = sq;
+        } else if (std::isupper(c)) {
+            white += c;
+        } else if (std::islower(c)) {
+            black += c;
+        }
+    }
+    if (white_king < 0 || black_king < 0 || white.size() + black.size() + 2 > size_t(MAX_PIECES)) {
+        return false;
+    }
+
+    material = make_material(white, black);
+    bool swap = !material.is_canonical();
+    int flip = swap ? 56 : 0;
+    if (swap) {
+        material = material.swapped();
+    }
+    placement.black_to_move = cr.white == swap;
+
+    // Fill the slots in material order, identical pieces in any order
+    std::vector<char> pieces = material.pieces;
+    for (int sq = 0; sq < 64; sq++) {
+        char c = cr.squares[sq];
+        if (c == ' ') {
+            continue;
+        }
+        if (swap) {
+            c = char(std::isupper(c) ? std::tolower(c) : std::toupper(c));
+        }
+        auto slot = std::find(pieces.begin(), pieces.end(), c);
+        placement.squares[slot - pieces.begin()] = uint8_t(sq ^ flip);
+        *slot = ' ';
+    }
+    return true;
+}
+
+std::vector<uint8_t> compress_dtm(const std::vector<uint8_t>& values) {
+    uint64_t blocks = (values.size() + DTM_BLOCK - 1) / DTM_BLOCK;
+    std::vector<uint8_t> section(blocks * sizeof(uint64_t));
+    for (uint64_t b = 0; b < blocks; b++) {
+        uint64_t begin = b * DTM_BLOCK;
+        uint64_t end = std::min<uint64_t>(values.size(), begin + DTM_BLOCK);
+
+        std::vector<uint8_t> palette;
+        uint8_t slot[256] = {};
+        bool seen[256] = {};
+        for (uint64_t idx = begin; idx < end; idx++) {
+            uint8_t v = values[idx];
+            if (v != VALUE_ILLEGAL && !seen[v]) {
+                seen[v] = true;
+                slot[v] = uint8_t(palette.size());
+                palette.push_back(v);
+            }
+        }
+        if (palette.empty()) {
+            palette.push_back(VALUE_DRAW);
+        }
+        int bits = palette_bits(unsigned(palette.size()));
+
+        uint64_t offset = section.size();
+        std::memcpy(section.data() + b * sizeof(uint64_t), &offset, sizeof(offset));
+        section.push_back(uint8_t(palette.size()));
+        section.insert(section.end(), palette.begin(), palette.end());
+        // One spare byte, read_dtm reads two at a time
+        std::vector<uint8_t> packed(((end - begin) * bits + 7) / 8 + 1);
+        for (uint64_t idx = begin; idx < end; idx++) {
+            uint64_t bit = (idx - begin) * bits;
+            unsigned code = values[idx] == VALUE_ILLEGAL ? 0 : slot[values[idx]];
+            packed[bit / 8] |= uint8_t(code << (bit % 8));
+            packed[bit / 8 + 1] |= uint8_t(code << (bit % 8) >> 8);
+        }
+        section.insert(section.end(), packed.begin(), packed.end());
+    }
+    return section;
+}
+
+uint8_t read_dtm(const uint8_t* section, uint64_t index) {
+    uint64_t offset;
+    std::memcpy(&offset, section + index / DTM_BLOCK * sizeof(uint64_t), sizeof(offset));
+    const uint8_t* block = section + offset;
+    unsigned count = block[0];
+    const uint8_t* palette = block + 1;
+    int bits = palette_bits(count);
+    uint64_t bit = index % DTM_BLOCK * bits;
+    const uint8_t* packed = palette + count + bit / 8;
+    unsigned word = packed[0] | unsigned(packed[1]) << 8;
+    return palette[(word >> (bit % 8)) & ((1u << bits) - 1)];
+}
+
+bool check_dtm(const uint8_t* section, uint64_t size, uint64_t entries) {
+    uint64_t blocks = (entries + DTM_BLOCK - 1) / DTM_BLOCK;
+    if (blocks * sizeof(uint64_t) > size) {
+        return false;
+    }
+    for (uint64_t b = 0; b < blocks; b++) {
+        uint64_t offset;
+        std::memcpy(&offset, section + b * sizeof(uint64_t), sizeof(offset));
+        if (offset >= size || section[offset] == 0) {
+            return false;
+        }
+        unsigned count = section[offset];
+        int bits = palette_bits(count);
+        uint64_t length = std::min(DTM_BLOCK, entries - b * DTM_BLOCK);
+        if (offset + 1 + count + (length * bits + 7) / 8 + 1 > size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace egtb
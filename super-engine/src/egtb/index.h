@@ -0,0 +1,129 @@
+#ifndef EGTB_INDEX_H
+#define EGTB_INDEX_H
+
+#include "thc.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ *  egtb index
+ *
+ *  What the generator and the prober agree on: material sets, how a position maps to an index and the
+ *  layout of a table file.
+ *
+ *  A material set lists its pieces as thc chars, White's king and pieces first, then Black's ("KRvKN" is
+ *  K R k n). A position is one square (thc numbering, a8 = 0) per listed piece plus the side to move.
+ *
+ *  The White king is brought to files a-d by mirroring the board, and without pawns also to ranks 1-4
+ *  by flipping it, which leaves 16 (32 with pawns) squares for it. The kings are indexed as a pair, which
+ *  leaves out the Black king on or next to the White one. The other pieces follow in groups of identical
+ *  pieces, all pieces before the pawns. A group of k is indexed as a k-subset of the squares still free
+ *  (combinatorial number system), so identical pieces share one index and no piece can stand on a king or
+ *  an earlier piece. Pawns only use the 48 squares of ranks 2-7 and only avoid earlier pawns:
+ *
+ *      index = ((black_to_move * king_pairs + pair) * subsets(group 1) + subset(group 1)) * ...
+ *
+ *  What the index can't leave out (a pawn on a piece, the side that just moved in check) is stored as
+ *  VALUE_ILLEGAL.
+ */
+
+namespace egtb {
+
+constexpr int MIN_PIECES = 3;
+constexpr int MAX_PIECES = 5;
+
+// Table values, one byte per index in memory: draw, illegal, or plies to mate + 1 (even plies are a loss
+// for the side to move, odd plies a win)
+constexpr uint8_t VALUE_DRAW = 0;
+constexpr uint8_t VALUE_ILLEGAL = 255;
+constexpr int MAX_MATE_PLIES = 253;
+
+inline bool is_decisive(uint8_t v) { return v != VALUE_DRAW && v != VALUE_ILLEGAL; }
+inline int mate_plies(uint8_t v) { return v - 1; }
+inline bool is_win(uint8_t v) { return is_decisive(v) && (mate_plies(v) & 1); }
+inline bool is_loss(uint8_t v) { return is_decisive(v) && !(mate_plies(v) & 1); }
+
+// Identical pieces in consecutive slots of a material set, indexed together
+struct PieceGroup {
+    int first;                  // Slot of the first one
+    int count;
+    bool pawns;
+    uint64_t subsets;           // Number of indices
+};
+
+struct Material {
+    std::vector<char> pieces;   // White king, White's pieces (QRBNP order), Black king, Black's pieces
+    int black_king_slot = 0;    // Position of the Black king in pieces
+    bool has_pawns = false;
+    std::vector<PieceGroup> groups;     // In index order, pieces before pawns
+
+    // "KRvKN", pieces in any order on each side. False for anything that isn't 2-MAX_PIECES pieces with
+    // one king per side.
+    static bool parse(const std::string& name, Material& out);
+
+    std::string name() const;
+    int count() const { return int(pieces.size()); }
+    uint64_t size() const;      // Number of indices
+
+    // Material after White and Black swap colors
+    Material swapped() const;
+
+    // Tables are stored with the stronger side (more queens, then rooks, ...) as White
+    bool is_canonical() const;
+
+    // Only then can a double push be taken en passant, so only these tables analyse en passant positions
+    bool pawns_on_both_sides() const;
+};
+
+// Squares by piece (same order as Material::pieces) and side to move
+struct Placement {
+    uint8_t squares[MAX_PIECES];
+    bool black_to_move;
+};
+
+uint64_t encode(const Material& m, Placement p);
+Placement decode(const Material& m, uint64_t index);
+
+// Find the table orientation of a board: sets material to the canonical material and placement to the
+// board seen from it (colors swapped and board flipped when Black is the stronger side). False when
+// the board doesn't fit a table (too many pieces, castling rights, en passant square).
+bool placement_of(const thc::ChessRules& cr, Material& material, Placement& placement);
+
+// On disk: a 64 byte header, then the WDL section (2 bits per index: 0 draw, 1 win, 2 loss, 3 illegal)
+// and the DTM section (the byte values above, compressed in blocks), each starting on a 64 byte boundary
+struct FileHeader {
+    char magic[4];              // "418E"
+    uint32_t version;
+    uint64_t entries;
+    uint64_t wdl_offset;
+    uint64_t dtm_offset;
+    char material[16];          // Name, zero padded
+    uint64_t dtm_size;          // Bytes
+    uint8_t pad[8];
+};
+
+static_assert(sizeof(FileHeader) == 64, "table header must be 64 bytes");
+
+constexpr uint32_t FILE_VERSION = 2;
+
+// The DTM section starts with an offset (from the start of the section) for every DTM_BLOCK indices. A
+// block is a palette of the values in it, a count byte and the values, followed by one palette slot per
+// index, packed into as few bits as the palette needs. Illegal indices take the first slot, the WDL
+// section tells them apart.
+constexpr uint64_t DTM_BLOCK = 4096;
+
+std::vector<uint8_t> compress_dtm(const std::vector<uint8_t>& values);
+
+// Value at index, which must be legal, in a section from compress_dtm
+uint8_t read_dtm(const uint8_t* section, uint64_t index);
+
+// The block offsets and palettes of a section stay within its size
+bool check_dtm(const uint8_t* section, uint64_t size, uint64_t entries);
+constexpr const char* FILE_SUFFIX = ".egtb";
+
+enum WdlCode { WDL_DRAW = 0, WDL_WIN = 1, WDL_LOSS = 2, WDL_ILLEGAL = 3 };
+
+} // namespace egtb
+
+#endif // EGTB_INDEX_H
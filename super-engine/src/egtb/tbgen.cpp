@@ -0,0 +1,70 @@
+/*
+ *  tbgen
+ *
+ *  Generates .egtb distance to mate tables (see egtb/generator.h) for the engine's --egtb option.
+ *
+ *      make tbgen
+ *      ./tbgen -o tables KRvK KQvKR     tables for these material sets and everything they convert into
+ *      ./tbgen -o tables --all 4        every 3 and 4 piece table
+ *
+ *  -j sets the number of worker threads (one per hardware thread by default). Tables already in the
+ *  output directory are reused. 5 piece tables work the same way but need up to a few GB of memory while
+ *  they are built (4 bytes per index, up to 4.1e8 indices without pawns and 6.6e8 with). In a
+ *  make SEARCH_TRACE=1 build, --trace <file> writes a timeline of the worker threads (see search-trace.h).
+ */
+
+#include "generator.h"
+#include "index.h"
+#include "options.h"
+#include "search-trace.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    egtb::GeneratorOptions options;
+    options.log = &std::cout;
+    std::vector<std::string> materials;
+    std::string trace_path;
+    int pieces;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            options.directory = argv[++i];
+        } else if (arg == "-j" && i + 1 < argc && parse_int(argv[i + 1], options.threads) && options.threads >= 0) {
+            i++;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--all" && i + 1 < argc && parse_int(argv[i + 1], pieces) && pieces >= egtb::MIN_PIECES
+                   && pieces <= egtb::MAX_PIECES) {
+            for (const std::string& name : egtb::all_materials(pieces)) {
+                materials.push_back(name);
+            }
+            i++;
+        } else if (!arg.empty() && arg[0] != '-') {
+            materials.push_back(arg);
+        } else {
+            materials.clear();
+            break;
+        }
+    }
+    if (materials.empty()) {
+        std::cout << "Usage: " << argv[0] << " [-o <dir>] [-j <threads>] [--trace <file>]"
+                  << " (--all <pieces, " << egtb::MIN_PIECES << "-" << egtb::MAX_PIECES << "> | <material>...)" << std::endl;
+        return 1;
+    }
+    if (!trace_path.empty()) {
+        if (!SEARCH_TRACE_ENABLED) {
+            std::cout << "--trace needs a build with make SEARCH_TRACE=1, no trace is written" << std::endl;
+        }
+        SEARCH_TRACE_OUTPUT(trace_path);
+    }
+
+    for (const std::string& name : materials) {
+        if (!egtb::generate(name, options)) {
+            return 1;
+        }
+    }
+    return 0;
+}
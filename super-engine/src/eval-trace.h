@@ -0,0 +1,123 @@
+#ifndef EVAL_TRACE_H
+#define EVAL_TRACE_H
+
+/*
+ *  eval-trace
+ *
+ *  Per-term profile of the static evaluation: how often each term ran, the score it contributed and the
+ *  time it took (TSC cycles on x86, steady_clock nanoseconds elsewhere). Build with
+ *
+ *      make clean && make EVAL_TRACE=1
+ *
+ *  to enable it. Otherwise the EVAL_TRACE_* macros expand to nothing and none of this is compiled in.
+ *
+ *      EVAL_TRACE_BEGIN(MOBILITY);
+ *      int mobility = ...;
+ *      EVAL_TRACE_END(MOBILITY, mobility);
+ *
+ *  SerialEngine::solve prints the breakdown after each search, main --eval-fens prints it for a FEN file.
+ */
+
+#ifdef EVAL_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <ostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace eval_trace {
+
+enum Term { MATERIAL, PSQ, MOBILITY, PAWNS, KING_SAFETY, KING_ACTIVITY, NNUE, TOTAL, TERM_COUNT };
+
+constexpr const char* TERM_NAMES[TERM_COUNT] = {
+    "material", "psq", "mobility", "pawns", "king safety", "king activity", "nnue", "total"
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+constexpr const char* TICK_UNIT = "cycles";
+inline uint64_t ticks() {
+    return __rdtsc();
+}
+#else
+constexpr const char* TICK_UNIT = "ns";
+inline uint64_t ticks() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+struct TermStats {
+    uint64_t calls = 0;
+    int64_t score_sum = 0;
+    int64_t abs_score_sum = 0;
+    uint64_t ticks = 0;
+};
+
+struct Trace {
+    TermStats terms[TERM_COUNT];
+    uint64_t lazy_exits = 0;
+
+    void record(Term term, int score, uint64_t elapsed) {
+        TermStats& t = terms[term];
+        t.calls++;
+        t.score_sum += score;
+        t.abs_score_sum += std::abs(score);
+        t.ticks += elapsed;
+    }
+
+    void reset() {
+        *this = Trace();
+    }
+
+    // One row per term that ran: calls, mean score, mean |score|, mean time and share of the eval time
+    void print(std::ostream& out) const {
+        uint64_t total_ticks = terms[TOTAL].ticks ? terms[TOTAL].ticks : 1;
+        out << std::left << std::setw(14) << "term" << std::right
+            << std::setw(12) << "calls" << std::setw(12) << "mean" << std::setw(12) << "mean |x|"
+            << std::setw(14) << TICK_UNIT << std::setw(9) << "time %" << "\n";
+        for (int i = 0; i < TERM_COUNT; i++) {
+            const TermStats& t = terms[i];
+            if (!t.calls) {
+                continue;
+            }
+            out << std::left << std::setw(14) << TERM_NAMES[i] << std::right << std::fixed << std::setprecision(1)
+                << std::setw(12) << t.calls
+                << std::setw(12) << double(t.score_sum) / t.calls
+                << std::setw(12) << double(t.abs_score_sum) / t.calls
+                << std::setw(14) << double(t.ticks) / t.calls
+                << std::setw(9) << 100.0 * t.ticks / total_ticks << "\n";
+        }
+        out << "lazy exits: " << lazy_exits << std::endl;
+        out.unsetf(std::ios::floatfield);
+    }
+};
+
+// Per thread like perf-counters' profile, so engines searching on several threads (bench-scaling) don't
+// race on the counters. solve() resets and prints the trace of the thread it runs on.
+inline thread_local Trace trace;
+
+} // namespace eval_trace
+
+#define EVAL_TRACE_BEGIN(term) uint64_t eval_trace_start_##term = eval_trace::ticks()
+#define EVAL_TRACE_END(term, score) \
+    eval_trace::trace.record(eval_trace::term, static_cast<int>(score), eval_trace::ticks() - eval_trace_start_##term)
+#define EVAL_TRACE_LAZY_EXIT() (eval_trace::trace.lazy_exits++)
+#define EVAL_TRACE_RESET() eval_trace::trace.reset()
+#define EVAL_TRACE_PRINT(out) eval_trace::trace.print(out)
+
+#else
+
+#define EVAL_TRACE_BEGIN(term) ((void)0)
+#define EVAL_TRACE_END(term, score) ((void)0)
+#define EVAL_TRACE_LAZY_EXIT() ((void)0)
+#define EVAL_TRACE_RESET() ((void)0)
+#define EVAL_TRACE_PRINT(out) ((void)0)
+
+#endif // EVAL_TRACE
+
+#endif // EVAL_TRACE_H
@@ -0,0 +1,150 @@
+#include "kpk.h"
+#include "bitboard.h"
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace kpk {
+
+namespace {
+
+// Positions are indexed by White king, Black king, side to move and pawn square, with White owning the
+// pawn on files a-d and rows 1-6 (ranks 7 to 2):
+//
+//      bits 0-5 White king, 6-11 Black king, 12 Black to move, 13-14 pawn file, 15-17 pawn row - 1
+constexpr int MAX_INDEX = 2 * 24 * 64 * 64;
+
+uint32_t bitbase[MAX_INDEX / 32];
+std::once_flag built;
+
+int index(int black_to_move, int black_king, int white_king, int pawn) {
+    return white_king | black_king << 6 | black_to_move << 12 | (pawn % 8) << 13 | (pawn / 8 - 1) << 15;
+}
+
+enum Result : uint8_t {
+    INVALID = 0,
+    UNKNOWN = 1,
+    DRAW = 2,
+    WIN = 4
+};
+
+int distance(int a, int b) {
+    int files = a % 8 > b % 8 ? a % 8 - b % 8 : b % 8 - a % 8;
+    int rows = a / 8 > b / 8 ? a / 8 - b / 8 : b / 8 - a / 8;
+    return files > rows ? files : rows;
+}
+
+// Result known from the position alone: illegal, promotion that can't be stopped, stalemate or the pawn
+// falling. North is towards row 0, so the square in front of the pawn is pawn - 8.
+Result classify_leaf(int black_to_move, int white_king, int black_king, int pawn) {
+    if (distance(white_king, black_king) <= 1 || white_king == pawn || black_king == pawn) {
+        return INVALID;
+    }
+    if (!black_to_move && (pawn_attacks(square_bb(pawn), true) & square_bb(black_king))) {
+        return INVALID;
+    }
+
+    int push = pawn - 8;
+    if (!black_to_move && pawn / 8 == 1 && white_king != push
+        && (distance(black_king, push) > 1 || distance(white_king, push) == 1)) {
+        return WIN;
+    }
+
+    if (black_to_move) {
+        Bitboard covered = king_attacks(white_king) | pawn_attacks(square_bb(pawn), true);
+        if (!(king_attacks(black_king) & ~covered)) {
+            return DRAW;
+        }
+        if ((king_attacks(black_king) & square_bb(pawn)) && !(king_attacks(white_king) & square_bb(pawn))) {
+            return DRAW;
+        }
+    }
+    return UNKNOWN;
+}
+
+// Combine the results of every move: a move to a good result decides it, otherwise one still unknown
+// keeps it open, otherwise every move is bad. Moves into illegal positions look up INVALID and drop out.
+Result classify(const std::vector<uint8_t>& db, int black_to_move, int white_king, int black_king, int pawn) {
+    Result good = black_to_move ? DRAW : WIN;
+    Result bad = black_to_move ? WIN : DRAW;
+
+    int r = INVALID;
+    if (black_to_move) {
+        for (Bitboard b = king_attacks(black_king); b; ) {
+            r |= db[index(0, pop_lsb(b), white_king, pawn)];
+        }
+    } else {
+        for (Bitboard b = king_attacks(white_king); b; ) {
+            r |= db[index(1, black_king, pop_lsb(b), pawn)];
+        }
+
+        // Pawn pushes, promotions were already classified as wins by classify_leaf
+        int push = pawn - 8;
+        if (pawn / 8 > 1) {
+            r |= db[index(1, black_king, white_king, push)];
+        }
+        if (pawn / 8 == 6 && push != white_king && push != black_king) {
+            r |= db[index(1, black_king, white_king, push - 8)];
+        }
+    }
+
+    return (r & good) ? good : (r & UNKNOWN) ? UNKNOWN : bad;
+}
+
+void build() {
+    std::vector<uint8_t> db(MAX_INDEX);
+
+    for (int idx = 0; idx < MAX_INDEX; idx++) {
+        int white_king = idx & 63;
+        int black_king = (idx >> 6) & 63;
+        int black_to_move = (idx >> 12) & 1;
+        int pawn = ((idx >> 15) + 1) * 8 + ((idx >> 13) & 3);
+        db[idx] = classify_leaf(black_to_move, white_king, black_king, pawn);
+    }
+
+    // Retrograde iteration, until no unknown position can be resolved any more (those are draws)
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int idx = 0; idx < MAX_INDEX; idx++) {
+            if (db[idx] != UNKNOWN) {
+                continue;
+            }
+            int pawn = ((idx >> 15) + 1) * 8 + ((idx >> 13) & 3);
+            db[idx] = classify(db, (idx >> 12) & 1, idx & 63, (idx >> 6) & 63, pawn);
+            changed |= db[idx] != UNKNOWN;
+        }
+    }
+
+    for (int idx = 0; idx < MAX_INDEX; idx++) {
+        if (db[idx] == WIN) {
+            bitbase[idx / 32] |= uint32_t(1) << (idx % 32);
+        }
+    }
+}
+
+} // namespace
+
+void init() {
+    std::call_once(built, build);
+}
+
+bool probe(int strong_king, int weak_king, int pawn, bool strong_is_white, bool white_to_move) {
+    // Flip Black's pawn to White's side of the board, then mirror the pawn onto files a-d
+    bool strong_to_move = strong_is_white == white_to_move;
+    if (!strong_is_white) {
+        strong_king ^= 56;
+        weak_king ^= 56;
+        pawn ^= 56;
+    }
+    if (pawn % 8 > 3) {
+        strong_king ^= 7;
+        weak_king ^= 7;
+        pawn ^= 7;
+    }
+
+    int idx = index(!strong_to_move, weak_king, strong_king, pawn);
+    return bitbase[idx / 32] & (uint32_t(1) << (idx % 32));
+}
+
+} // namespace kpk
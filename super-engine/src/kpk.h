@@ -0,0 +1,22 @@
+#ifndef KPK_H
+#define KPK_H
+
+/*
+ *  kpk
+ *
+ *  King and pawn against king bitbase. Every position with White's pawn on files a-d is classified as won
+ *  or drawn by retrograde iteration when the engine starts (a few milliseconds), and kept as one bit per
+ *  position. Other positions are flipped/mirrored into that range by probe.
+ */
+
+namespace kpk {
+
+// Build the bitbase, safe to call more than once
+void init();
+
+// Whether the side with the pawn wins. Squares are thc squares (a8 = 0, h1 = 63).
+bool probe(int strong_king, int weak_king, int pawn, bool strong_is_white, bool white_to_move);
+
+} // namespace kpk
+
+#endif // KPK_H
@@ -0,0 +1,155 @@
+#include "mailbox.h"
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Board chars are ' ' or a letter of PNBRQK, with bit 0x20 set for Black. With that bit cleared, the
+// low nibble of (c ^ c >> 4) tells the letters apart (and is 0 for the space), so it can index a 16 entry
+// shuffle table:  B -> 6, K -> F, N -> A, P -> 5, Q -> 4, R -> 7.
+constexpr uint8_t E = MAILBOX_EMPTY;
+alignas(16) constexpr uint8_t TYPE_LOOKUP[16] = {E, E, E, E, 4, 0, 2, 3, E, E, 1, E, E, E, E, 5};
+
+#if defined(__AVX2__)
+
+__m256i piece_indices_32(const char* squares) {
+    const __m256i lookup = _mm256_broadcastsi128_si256(
+        _mm_load_si128(reinterpret_cast<const __m128i*>(TYPE_LOOKUP)));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i black_bit = _mm256_set1_epi8(0x20);
+
+    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(squares));
+    __m256i upper = _mm256_andnot_si256(black_bit, c);
+    __m256i key = _mm256_and_si256(
+        _mm256_xor_si256(upper, _mm256_srli_epi16(upper, 4)), nibble);
+    __m256i type = _mm256_shuffle_epi8(lookup, key);
+    // +6 for Black. The space has the 0x20 bit too, the min folds its 12 + 6 back to MAILBOX_EMPTY.
+    __m256i offset = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(c, black_bit), black_bit),
+                                      _mm256_set1_epi8(6));
+    return _mm256_min_epu8(_mm256_add_epi8(type, offset), _mm256_set1_epi8(E));
+}
+
+#elif defined(__SSE4_1__)
+
+__m128i piece_indices_16(const char* squares) {
+    const __m128i lookup = _mm_load_si128(reinterpret_cast<const __m128i*>(TYPE_LOOKUP));
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i black_bit = _mm_set1_epi8(0x20);
+
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(squares));
+    __m128i upper = _mm_andnot_si128(black_bit, c);
+    __m128i key = _mm_and_si128(_mm_xor_si128(upper, _mm_srli_epi16(upper, 4)), nibble);
+    __m128i type = _mm_shuffle_epi8(lookup, key);
+    __m128i offset = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(c, black_bit), black_bit),
+                                   _mm_set1_epi8(6));
+    return _mm_min_epu8(_mm_add_epi8(type, offset), _mm_set1_epi8(E));
+}
+
+#endif
+
+int scalar_piece_index(char c) {
+    uint8_t upper = static_cast<uint8_t>(c) & ~0x20;
+    uint8_t type = TYPE_LOOKUP[(upper ^ (upper >> 4)) & 0x0F];
+    if (type == E) {
+        return E;
+    }
+    return (c & 0x20) ? type + 6 : type;
+}
+
+} // namespace
+
+void mailbox_piece_indices_scalar(const char squares[64], uint8_t pieces[64]) {
+    for (int sq = 0; sq < 64; sq++) {
+        pieces[sq] = scalar_piece_index(squares[sq]);
+    }
+}
+
+void mailbox_piece_indices(const char squares[64], uint8_t pieces[64]) {
+#if defined(__AVX2__)
+    for (int sq = 0; sq < 64; sq += 32) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pieces + sq), piece_indices_32(squares + sq));
+    }
+#elif defined(__SSE4_1__)
+    for (int sq = 0; sq < 64; sq += 16) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pieces + sq), piece_indices_16(squares + sq));
+    }
+#else
+    mailbox_piece_indices_scalar(squares, pieces);
+#endif
+}
+
+void mailbox_bitboards_scalar(const uint8_t pieces[64], Bitboard out[12]) {
+    for (int p = 0; p < 12; p++) {
+        out[p] = 0;
+    }
+    for (int sq = 0; sq < 64; sq++) {
+        if (pieces[sq] != E) {
+            out[pieces[sq]] |= square_bb(sq);
+        }
+    }
+}
+
+// One compare per piece and register, the byte mask of the matches is the bitboard
+void mailbox_bitboards(const uint8_t pieces[64], Bitboard out[12]) {
+#if defined(__AVX2__)
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pieces));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pieces + 32));
+    for (int p = 0; p < 12; p++) {
+        __m256i piece = _mm256_set1_epi8(static_cast<char>(p));
+        uint32_t lo_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, piece));
+        uint32_t hi_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, piece));
+        out[p] = Bitboard(lo_mask) | Bitboard(hi_mask) << 32;
+    }
+#elif defined(__SSE4_1__)
+    __m128i v[4];
+    for (int i = 0; i < 4; i++) {
+        v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pieces + 16 * i));
+    }
+    for (int p = 0; p < 12; p++) {
+        __m128i piece = _mm_set1_epi8(static_cast<char>(p));
+        Bitboard b = 0;
+        for (int i = 0; i < 4; i++) {
+            b |= Bitboard(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v[i], piece)))) << (16 * i);
+        }
+        out[p] = b;
+    }
+#else
+    mailbox_bitboards_scalar(pieces, out);
+#endif
+}
+
+int mailbox_psq_sum_scalar(const uint8_t pieces[64], const PieceSquareTable& table) {
+    int sum = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        if (pieces[sq] != E) {
+            sum += table[pieces[sq]][sq];
+        }
+    }
+    return sum;
+}
+
+// AVX2 gathers table[piece * 64 + square] for 8 squares at a time, masked off on empty squares. SSE4.1
+// has no gather, so it uses the scalar loop.
+int mailbox_psq_sum(const uint8_t pieces[64], const PieceSquareTable& table) {
+#if defined(__AVX2__)
+    const int* base = table[0].data();
+    const __m256i empty = _mm256_set1_epi32(E);
+    __m256i squares = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i sum = _mm256_setzero_si256();
+    for (int sq = 0; sq < 64; sq += 8) {
+        __m256i piece = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pieces + sq)));
+        __m256i index = _mm256_add_epi32(_mm256_slli_epi32(piece, 6), squares);
+        __m256i occupied = _mm256_cmpgt_epi32(empty, piece);
+        sum = _mm256_add_epi32(sum, _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), base, index, occupied, 4));
+        squares = _mm256_add_epi32(squares, _mm256_set1_epi32(8));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#else
+    return mailbox_psq_sum_scalar(pieces, table);
+#endif
+}
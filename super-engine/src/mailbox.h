@@ -0,0 +1,33 @@
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include "bitboard.h"
+#include <array>
+#include <cstdint>
+
+/*
+ *  mailbox
+ *
+ *  Whole-board kernels over thc's squares[64] char array. The board bytes are turned into piece indices
+ *  (PNBRQKpnbrqk = 0..11, MAILBOX_EMPTY for an empty square) with a byte shuffle lookup, and from those
+ *  come the piece bitboards and piece-square sums, 16 or 32 squares per instruction with SSE4.1/AVX2.
+ *  The _scalar versions are the reference (and the fallback on other targets).
+ */
+
+constexpr uint8_t MAILBOX_EMPTY = 12;
+
+// Piece-square table by piece index and square
+using PieceSquareTable = std::array<std::array<int, 64>, 12>;
+
+void mailbox_piece_indices(const char squares[64], uint8_t pieces[64]);
+void mailbox_piece_indices_scalar(const char squares[64], uint8_t pieces[64]);
+
+// Bitboard of every piece index
+void mailbox_bitboards(const uint8_t pieces[64], Bitboard out[12]);
+void mailbox_bitboards_scalar(const uint8_t pieces[64], Bitboard out[12]);
+
+// Sum of table[piece][square] over the occupied squares
+int mailbox_psq_sum(const uint8_t pieces[64], const PieceSquareTable& table);
+int mailbox_psq_sum_scalar(const uint8_t pieces[64], const PieceSquareTable& table);
+
+#endif // MAILBOX_H
@@ -2,8 +2,13 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <fstream>
 #include "thc.h"
 #include "serial-engine.h"
+#include "options.h"
+#include "tbprobe.h"
+#include "eval-trace.h"
+#include "search-trace.h"
 
 void print_board(thc::ChessRules& cr) {
     std::cout << cr.ToDebugStr() << std::endl;
@@ -14,18 +19,53 @@ int main(int argc, char* argv[]) {
     bool computer_is_white = false;
     bool computer_is_black = false;
 
+    std::string nnue_path;
+    float lazy_margin = -1.0f;
+    std::string eval_fens_path;
+    std::string syzygy_path;
+    std::string egtb_path;
+    std::string book_path;
+    std::string book_keys_path;
+    int book_depth = 20;
+    std::string stats_json_path;
+    std::string trace_path;
+
     // Parse command-line arguments
-    if (argc > 1) {
-        std::string arg = argv[1];
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
         if (arg == "--white") {
             computer_is_white = true;
         } else if (arg == "--black") {
             computer_is_black = true;
+        } else if (arg == "--nnue" && i + 1 < argc) {
+            nnue_path = argv[++i];
+        } else if (arg == "--lazy-margin" && i + 1 < argc && parse_float(argv[i + 1], lazy_margin) && lazy_margin >= 0.0f) {
+            i++;
+        } else if (arg == "--syzygy" && i + 1 < argc) {
+            syzygy_path = argv[++i];
+        } else if (arg == "--egtb" && i + 1 < argc) {
+            egtb_path = argv[++i];
+        } else if (arg == "--book" && i + 1 < argc) {
+            book_path = argv[++i];
+        } else if (arg == "--book-depth" && i + 1 < argc && parse_int(argv[i + 1], book_depth) && book_depth >= 0) {
+            i++;
+        } else if (arg == "--book-keys" && i + 1 < argc) {
+            book_keys_path = argv[++i];
+        } else if (arg == "--stats-json" && i + 1 < argc) {
+            stats_json_path = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--eval-fens" && i + 1 < argc) {
+            eval_fens_path = argv[++i];
         } else {
-            std::cout << "Usage: " << argv[0] << " [--white | --black]" << std::endl;
+            std::cout << "Usage: " << argv[0] << " [--white | --black] [--nnue <network file>] [--lazy-margin <centipawns>]"
+                      << " [--syzygy <dir[:dir...]>] [--egtb <dir[:dir...]>]"
+                      << " [--book <file> [--book-depth <plies>] [--book-keys <file>]] [--stats-json <file | ->]"
+                      << " [--trace <file>] [--eval-fens <file>]" << std::endl;
             return 1;
         }
-    } else {
+    }
+    if (!computer_is_white && !computer_is_black) {
         // Default to computer playing black
         computer_is_black = true;
     }
@@ -35,6 +75,76 @@ int main(int argc, char* argv[]) {
     cr.Forsyth("startpos");
 
     SerialEngine engine;
+    if (lazy_margin >= 0.0f) {
+        engine.set_lazy_eval_margins(lazy_margin, lazy_margin);
+    }
+
+    if (!syzygy_path.empty() && !syzygy::SEARCH_ENABLED) {
+        std::cout << "--syzygy needs a build with make SYZYGY=1, the tables are not used" << std::endl;
+    } else if (!syzygy_path.empty()) {
+        int largest = engine.set_syzygy_path(syzygy_path);
+        std::cout << "Syzygy: " << (largest ? "tables up to " + std::to_string(largest) + " pieces" : "no tables found")
+                  << " in " << syzygy_path << std::endl;
+    }
+    if (!book_keys_path.empty() && !book::load_keys(book_keys_path)) {
+        std::cout << "Could not read 781 book keys from " << book_keys_path << std::endl;
+        return 1;
+    }
+    if (!book_path.empty()) {
+        bool opened = engine.set_book(book_path, book_depth);
+        std::cout << "Book: " << (opened ? "using " : "could not open ") << book_path << std::endl;
+    }
+    if (!egtb_path.empty()) {
+        int largest = engine.set_egtb_path(egtb_path);
+        std::cout << "EGTB: " << (largest ? "tables up to " + std::to_string(largest) + " pieces" : "no tables found")
+                  << " in " << egtb_path << std::endl;
+    }
+
+    // One JSON line of search statistics per search, to stdout for "-"
+    std::ofstream stats_json;
+    if (stats_json_path == "-") {
+        engine.set_stats_output(&std::cout);
+    } else if (!stats_json_path.empty()) {
+        stats_json.open(stats_json_path, std::ios::app);
+        if (!stats_json) {
+            std::cout << "Could not open " << stats_json_path << std::endl;
+            return 1;
+        }
+        engine.set_stats_output(&stats_json);
+    }
+
+    // Chrome trace JSON of the searches, rewritten after each one (SEARCH_TRACE builds only)
+    if (!trace_path.empty()) {
+        if (!SEARCH_TRACE_ENABLED) {
+            std::cout << "--trace needs a build with make SEARCH_TRACE=1, no trace is written" << std::endl;
+        }
+        SEARCH_TRACE_OUTPUT(trace_path);
+        SEARCH_TRACE_THREAD_NAME("search");
+    }
+
+    if (!nnue_path.empty() && !engine.load_network(nnue_path)) {
+        std::cout << "Could not load network " << nnue_path << ", using classical evaluation" << std::endl;
+    }
+
+    // Print the static eval of every FEN in the file (one per line) and, in EVAL_TRACE builds, the breakdown
+    if (!eval_fens_path.empty()) {
+        std::ifstream fens(eval_fens_path);
+        if (!fens) {
+            std::cout << "Could not open " << eval_fens_path << std::endl;
+            return 1;
+        }
+        EVAL_TRACE_RESET();
+        std::string fen;
+        while (std::getline(fens, fen)) {
+            thc::ChessRules position;
+            if (fen.empty() || !position.Forsyth(fen.c_str())) {
+                continue;
+            }
+            std::cout << engine.evaluate(position) << " " << fen << std::endl;
+        }
+        EVAL_TRACE_PRINT(std::cout);
+        return 0;
+    }
 
     bool game_over = false;
     thc::TERMINAL terminal;
@@ -44,6 +154,7 @@ int main(int argc, char* argv[]) {
             if (computer_is_white) {
                 // Computer's turn
                 thc::Move best_move = engine.solve(cr, true);
+                SEARCH_TRACE_WRITE();
                 std::cout << "Computer (White) plays: " << best_move.NaturalOut(&cr) << std::endl;
                 cr.PushMove(best_move);
             } else {
@@ -72,6 +183,7 @@ int main(int argc, char* argv[]) {
             if (computer_is_black) {
                 // Computer's turn
                 thc::Move best_move = engine.solve(cr, false);
+                SEARCH_TRACE_WRITE();
                 std::cout << "Computer (Black) plays: " << best_move.NaturalOut(&cr) << std::endl;
                 cr.PushMove(best_move);
             } else {
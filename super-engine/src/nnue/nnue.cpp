@@ -0,0 +1,528 @@
+#include "nnue.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace nnue {
+
+namespace {
+
+// Network file: 64 byte header followed by the layers, each section starting on a 64 byte boundary.
+// Sections are stored exactly as the kernels read them (feature-major transformer rows, [out][in] dense
+// rows), so the file is mapped read-only and used in place without any parsing or copying. Processes
+// mapping the same file share its pages through the page cache.
+//
+// The header carries a hash of the architecture (so a net trained for other dimensions is rejected)
+// and an FNV-1a hash of everything after the header (so a truncated or corrupted file is rejected).
+constexpr char FILE_MAGIC[4] = {'4', '1', '8', 'N'};
+constexpr uint32_t FILE_VERSION = 2;
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t input_dims;
+    uint32_t l1;
+    uint32_t l2;
+    uint32_t l3;
+    uint64_t arch_hash;
+    uint64_t payload_hash;
+    char padding[24];
+};
+static_assert(sizeof(FileHeader) == 64, "network header must be one cache line");
+
+struct Layout {
+    size_t ft_biases, ft_weights;
+    size_t l2_biases, l2_weights;
+    size_t l3_biases, l3_weights;
+    size_t out_bias, out_weights;
+    size_t total;
+};
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Everything that changes how the weights are interpreted goes into the architecture hash
+uint64_t architecture_hash() {
+    const uint32_t dims[] = {
+        KING_BUCKETS, PIECE_SQUARES, INPUT_DIMS, L1, L2, L3, WEIGHT_SCALE_BITS, OUTPUT_SCALE
+    };
+    return fnv1a(dims, sizeof(dims));
+}
+
+Layout file_layout() {
+    Layout layout;
+    size_t offset = sizeof(FileHeader);
+    auto place = [&offset](size_t bytes) {
+        size_t at = offset;
+        offset += (bytes + 63) & ~size_t(63);
+        return at;
+    };
+    layout.ft_biases   = place(L1 * sizeof(int16_t));
+    layout.ft_weights  = place(size_t(INPUT_DIMS) * L1 * sizeof(int16_t));
+    layout.l2_biases   = place(L2 * sizeof(int32_t));
+    layout.l2_weights  = place(L2 * 2 * L1 * sizeof(int8_t));
+    layout.l3_biases   = place(L3 * sizeof(int32_t));
+    layout.l3_weights  = place(L3 * L2 * sizeof(int8_t));
+    layout.out_bias    = place(sizeof(int32_t));
+    layout.out_weights = place(L3 * sizeof(int8_t));
+    layout.total = offset;
+    return layout;
+}
+
+// King bucket by square, seen from the perspective's own side (own back rank at the bottom).
+// Only files a-d are looked up since the board is mirrored to keep the king there.
+const int king_bucket_table[64] = {
+    6, 6, 7, 7, 7, 7, 6, 6,
+    6, 6, 7, 7, 7, 7, 6, 6,
+    6, 6, 7, 7, 7, 7, 6, 6,
+    6, 6, 7, 7, 7, 7, 6, 6,
+    4, 4, 5, 5, 5, 5, 4, 4,
+    4, 4, 5, 5, 5, 5, 4, 4,
+    2, 2, 3, 3, 3, 3, 2, 2,
+    0, 0, 1, 1, 1, 1, 0, 0
+};
+
+int piece_type(char piece) {
+    switch (tolower(piece)) {
+        case 'p': return 0;
+        case 'n': return 1;
+        case 'b': return 2;
+        case 'r': return 3;
+        case 'q': return 4;
+        case 'k': return 5;
+        default: return -1;
+    }
+}
+
+const char PIECE_CHARS[] = "PNBRQKpnbrqk";
+
+// Index into RefreshCache::Entry::pieces
+int piece_index(char piece) {
+    return piece_type(piece) + (islower(piece) ? 6 : 0);
+}
+
+bool is_king_of(char piece, int perspective) {
+    return piece == (perspective == WHITE ? 'K' : 'k');
+}
+
+// SIMD kernels. AVX2 works on 256 bit registers, SSE4.1 on 128 bit ones and the scalar versions are
+// the reference implementation used everywhere else.
+
+// dst = src + sum(add rows) - sum(sub rows), L1 lanes
+void apply_rows(const int16_t* src, int16_t* dst,
+                const int16_t* const add[], int add_count,
+                const int16_t* const sub[], int sub_count) {
+#if defined(__AVX2__)
+    for (int i = 0; i < L1; i += 16) {
+        __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(src + i));
+        for (int k = 0; k < add_count; k++)
+            v = _mm256_add_epi16(v, _mm256_load_si256(reinterpret_cast<const __m256i*>(add[k] + i)));
+        for (int k = 0; k < sub_count; k++)
+            v = _mm256_sub_epi16(v, _mm256_load_si256(reinterpret_cast<const __m256i*>(sub[k] + i)));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(dst + i), v);
+    }
+#elif defined(__SSE4_1__)
+    for (int i = 0; i < L1; i += 8) {
+        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(src + i));
+        for (int k = 0; k < add_count; k++)
+            v = _mm_add_epi16(v, _mm_load_si128(reinterpret_cast<const __m128i*>(add[k] + i)));
+        for (int k = 0; k < sub_count; k++)
+            v = _mm_sub_epi16(v, _mm_load_si128(reinterpret_cast<const __m128i*>(sub[k] + i)));
+        _mm_store_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+#else
+    for (int i = 0; i < L1; i++) {
+        int16_t v = src[i];
+        for (int k = 0; k < add_count; k++) v += add[k][i];
+        for (int k = 0; k < sub_count; k++) v -= sub[k][i];
+        dst[i] = v;
+    }
+#endif
+}
+
+// Clipped ReLU of the accumulator: clamp(x, 0, 127) packed into bytes
+void clip_accumulator(const int16_t* in, uint8_t* out) {
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    for (int i = 0; i < L1; i += 32) {
+        __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i + 16));
+        __m256i packed = _mm256_max_epi8(_mm256_packs_epi16(a, b), zero);
+        // packs works per 128 bit lane, put the quadwords back in order
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(out + i), packed);
+    }
+#elif defined(__SSE4_1__)
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < L1; i += 16) {
+        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+        _mm_store_si128(reinterpret_cast<__m128i*>(out + i), _mm_max_epi8(_mm_packs_epi16(a, b), zero));
+    }
+#else
+    for (int i = 0; i < L1; i++) {
+        out[i] = static_cast<uint8_t>(std::clamp<int>(in[i], 0, 127));
+    }
+#endif
+}
+
+// out[o] = bias[o] + sum_i in[i] * weights[o][i], in_dims must be a multiple of 32
+void affine(const uint8_t* in, int in_dims, const int8_t* weights, const int32_t* biases,
+            int32_t* out, int out_dims) {
+#if defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi16(1);
+    for (int o = 0; o < out_dims; o++) {
+        const int8_t* row = weights + o * in_dims;
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < in_dims; i += 32) {
+            __m256i x = _mm256_load_si256(reinterpret_cast<const __m256i*>(in + i));
+            __m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(row + i));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(_mm256_maddubs_epi16(x, w), ones));
+        }
+        __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+        s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+        out[o] = biases[o] + _mm_cvtsi128_si32(s);
+    }
+#elif defined(__SSE4_1__)
+    const __m128i ones = _mm_set1_epi16(1);
+    for (int o = 0; o < out_dims; o++) {
+        const int8_t* row = weights + o * in_dims;
+        __m128i sum = _mm_setzero_si128();
+        for (int i = 0; i < in_dims; i += 16) {
+            __m128i x = _mm_load_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(row + i));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_maddubs_epi16(x, w), ones));
+        }
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        out[o] = biases[o] + _mm_cvtsi128_si32(sum);
+    }
+#else
+    for (int o = 0; o < out_dims; o++) {
+        const int8_t* row = weights + o * in_dims;
+        int32_t sum = biases[o];
+        for (int i = 0; i < in_dims; i++) {
+            sum += in[i] * row[i];
+        }
+        out[o] = sum;
+    }
+#endif
+}
+
+// Clipped ReLU between the dense layers
+void activate(const int32_t* in, uint8_t* out, int dims) {
+    for (int i = 0; i < dims; i++) {
+        out[i] = static_cast<uint8_t>(std::clamp(in[i] >> WEIGHT_SCALE_BITS, 0, 127));
+    }
+}
+
+} // namespace
+
+int touched_squares(const thc::Move& move, int out[4]) {
+    int count = 0;
+    out[count++] = move.src;
+    out[count++] = move.dst;
+    switch (move.special) {
+        case thc::SPECIAL_WK_CASTLING: out[count++] = thc::h1; out[count++] = thc::f1; break;
+        case thc::SPECIAL_WQ_CASTLING: out[count++] = thc::a1; out[count++] = thc::d1; break;
+        case thc::SPECIAL_BK_CASTLING: out[count++] = thc::h8; out[count++] = thc::f8; break;
+        case thc::SPECIAL_BQ_CASTLING: out[count++] = thc::a8; out[count++] = thc::d8; break;
+        case thc::SPECIAL_WEN_PASSANT: out[count++] = move.dst + 8; break;
+        case thc::SPECIAL_BEN_PASSANT: out[count++] = move.dst - 8; break;
+        default: break;
+    }
+    return count;
+}
+
+DirtyPieces diff_squares(const int touched[], const char before[], int count, const thc::ChessRules& after) {
+    DirtyPieces dirty;
+    dirty.king_square[WHITE] = after.wking_square;
+    dirty.king_square[BLACK] = after.bking_square;
+    for (int i = 0; i < count; i++) {
+        char now = after.squares[touched[i]];
+        if (now == before[i])
+            continue;
+        if (before[i] != ' ') {
+            dirty.removed_piece[dirty.removed_count] = before[i];
+            dirty.removed_square[dirty.removed_count++] = touched[i];
+        }
+        if (now != ' ') {
+            dirty.added_piece[dirty.added_count] = now;
+            dirty.added_square[dirty.added_count++] = touched[i];
+        }
+    }
+    return dirty;
+}
+
+int king_slot(int king_square, int perspective) {
+    int sq = perspective == WHITE ? king_square : (king_square ^ 56);
+    bool mirror = (sq & 7) >= 4;
+    return king_bucket_table[sq] + (mirror ? KING_BUCKETS : 0);
+}
+
+int feature_index(int perspective, int king_square, char piece, int square) {
+    int ksq = king_square;
+    int sq = square;
+    if (perspective == BLACK) {
+        ksq ^= 56;
+        sq ^= 56;
+    }
+    if ((ksq & 7) >= 4) {
+        ksq ^= 7;
+        sq ^= 7;
+    }
+    bool own = (isupper(piece) != 0) == (perspective == WHITE);
+    int piece_index = piece_type(piece) + (own ? 0 : 6);
+    return king_bucket_table[ksq] * PIECE_SQUARES + piece_index * 64 + sq;
+}
+
+bool needs_refresh(const DirtyPieces& dirty, int perspective) {
+    for (int i = 0; i < dirty.removed_count; i++) {
+        if (is_king_of(dirty.removed_piece[i], perspective) &&
+            king_slot(dirty.removed_square[i], perspective) != king_slot(dirty.king_square[perspective], perspective)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Network::Network() {}
+
+Network::~Network() {
+    release();
+}
+
+void Network::release() {
+    if (storage) {
+        munmap(const_cast<char*>(storage), storage_size);
+    }
+    storage = nullptr;
+    storage_size = 0;
+}
+
+bool Network::load(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "NNUE: cannot open " << path << std::endl;
+        return false;
+    }
+
+    Layout layout = file_layout();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != layout.total) {
+        std::cerr << "NNUE: " << path << " has the wrong size for this architecture" << std::endl;
+        close(fd);
+        return false;
+    }
+
+    // Page aligned, so every 64 byte aligned section offset is aligned in memory too
+    void* mapping = mmap(nullptr, layout.total, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "NNUE: cannot map " << path << std::endl;
+        return false;
+    }
+
+    const char* base = static_cast<const char*>(mapping);
+    FileHeader header;
+    memcpy(&header, base, sizeof(header));
+
+    const char* error = nullptr;
+    if (memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 || header.version != FILE_VERSION) {
+        error = "is not a network file";
+    } else if (header.arch_hash != architecture_hash() || header.input_dims != INPUT_DIMS ||
+               header.l1 != L1 || header.l2 != L2 || header.l3 != L3) {
+        error = "has a different architecture";
+    } else if (header.payload_hash != fnv1a(base + sizeof(header), layout.total - sizeof(header))) {
+        error = "is corrupted (payload hash mismatch)";
+    }
+    if (error) {
+        std::cerr << "NNUE: " << path << " " << error << std::endl;
+        munmap(mapping, layout.total);
+        return false;
+    }
+
+    // Only a valid file replaces the current network
+    release();
+    storage = base;
+    storage_size = layout.total;
+
+    ft_biases   = reinterpret_cast<const int16_t*>(storage + layout.ft_biases);
+    ft_weights  = reinterpret_cast<const int16_t*>(storage + layout.ft_weights);
+    l2_biases   = reinterpret_cast<const int32_t*>(storage + layout.l2_biases);
+    l2_weights  = reinterpret_cast<const int8_t*>(storage + layout.l2_weights);
+    l3_biases   = reinterpret_cast<const int32_t*>(storage + layout.l3_biases);
+    l3_weights  = reinterpret_cast<const int8_t*>(storage + layout.l3_weights);
+    out_bias    = reinterpret_cast<const int32_t*>(storage + layout.out_bias);
+    out_weights = reinterpret_cast<const int8_t*>(storage + layout.out_weights);
+    return true;
+}
+
+void Network::refresh(const thc::ChessRules& cr, Accumulator& acc) const {
+    refresh_perspective(cr, acc, WHITE);
+    refresh_perspective(cr, acc, BLACK);
+}
+
+void Network::refresh_perspective(const thc::ChessRules& cr, Accumulator& acc, int perspective) const {
+    int king_square = perspective == WHITE ? cr.wking_square : cr.bking_square;
+
+    // Gather the active features and add them in batches
+    const int16_t* rows[32];
+    int count = 0;
+    for (int sq = 0; sq < 64; sq++) {
+        char piece = cr.squares[sq];
+        if (piece == ' ')
+            continue;
+        rows[count++] = ft_weights + size_t(feature_index(perspective, king_square, piece, sq)) * L1;
+    }
+
+    apply_rows(ft_biases, acc.values[perspective], rows, std::min(count, 16), nullptr, 0);
+    if (count > 16) {
+        apply_rows(acc.values[perspective], acc.values[perspective], rows + 16, count - 16, nullptr, 0);
+    }
+    acc.computed[perspective] = true;
+}
+
+void Network::reset_cache(RefreshCache& cache) const {
+    for (auto& perspective_entries : cache.entries) {
+        for (auto& entry : perspective_entries) {
+            memcpy(entry.values, ft_biases, sizeof(entry.values));
+            memset(entry.pieces, 0, sizeof(entry.pieces));
+        }
+    }
+}
+
+void Network::refresh(const thc::ChessRules& cr, Accumulator& acc, RefreshCache& cache) const {
+    refresh_perspective(cr, acc, WHITE, cache);
+    refresh_perspective(cr, acc, BLACK, cache);
+}
+
+void Network::refresh_perspective(const thc::ChessRules& cr, Accumulator& acc, int perspective,
+                                  RefreshCache& cache) const {
+    int king_square = perspective == WHITE ? cr.wking_square : cr.bking_square;
+    RefreshCache::Entry& entry = cache.entries[perspective][king_slot(king_square, perspective)];
+
+    Bitboard pieces[12] = {};
+    for (int sq = 0; sq < 64; sq++) {
+        char piece = cr.squares[sq];
+        if (piece != ' ')
+            pieces[piece_index(piece)] |= square_bb(sq);
+    }
+
+    // Features are the same for every king square of a slot, so the current one indexes the cached board too
+    const int16_t* add[32];
+    const int16_t* sub[32];
+    int add_count = 0;
+    int sub_count = 0;
+    for (int i = 0; i < 12; i++) {
+        Bitboard removed = entry.pieces[i] & ~pieces[i];
+        Bitboard added = pieces[i] & ~entry.pieces[i];
+        while (removed) {
+            int sq = pop_lsb(removed);
+            sub[sub_count++] = ft_weights + size_t(feature_index(perspective, king_square, PIECE_CHARS[i], sq)) * L1;
+        }
+        while (added) {
+            int sq = pop_lsb(added);
+            add[add_count++] = ft_weights + size_t(feature_index(perspective, king_square, PIECE_CHARS[i], sq)) * L1;
+        }
+        entry.pieces[i] = pieces[i];
+    }
+
+    // Apply in batches so the vector loop keeps a bounded number of row pointers
+    int add_done = 0;
+    int sub_done = 0;
+    while (add_done < add_count || sub_done < sub_count) {
+        int add_batch = std::min(add_count - add_done, 8);
+        int sub_batch = std::min(sub_count - sub_done, 8);
+        apply_rows(entry.values, entry.values, add + add_done, add_batch, sub + sub_done, sub_batch);
+        add_done += add_batch;
+        sub_done += sub_batch;
+    }
+
+    memcpy(acc.values[perspective], entry.values, sizeof(entry.values));
+    acc.computed[perspective] = true;
+}
+
+void Network::update_perspective(const Accumulator& prev, Accumulator& next, const DirtyPieces& dirty,
+                                 int perspective) const {
+    int king_square = dirty.king_square[perspective];
+    const int16_t* add[2];
+    const int16_t* sub[2];
+    for (int i = 0; i < dirty.added_count; i++) {
+        add[i] = ft_weights + size_t(feature_index(perspective, king_square, dirty.added_piece[i],
+                                                   dirty.added_square[i])) * L1;
+    }
+    for (int i = 0; i < dirty.removed_count; i++) {
+        sub[i] = ft_weights + size_t(feature_index(perspective, king_square, dirty.removed_piece[i],
+                                                   dirty.removed_square[i])) * L1;
+    }
+    apply_rows(prev.values[perspective], next.values[perspective],
+               add, dirty.added_count, sub, dirty.removed_count);
+    next.computed[perspective] = true;
+}
+
+void Network::update_lazy(Accumulator stack[], const DirtyPieces dirty[], int ply, const thc::ChessRules& cr,
+                          RefreshCache& cache) const {
+    for (int perspective = WHITE; perspective <= BLACK; perspective++) {
+        // Find the nearest computed ancestor. Stop early if a king changed slot on the way, the plies above
+        // that move can't be updated incrementally so it's cheaper to refresh just this one.
+        int from = ply;
+        bool refresh = false;
+        while (!stack[from].computed[perspective]) {
+            if (from == 0 || needs_refresh(dirty[from], perspective)) {
+                refresh = true;
+                break;
+            }
+            from--;
+        }
+
+        if (refresh) {
+            refresh_perspective(cr, stack[ply], perspective, cache);
+            continue;
+        }
+
+        // Replay the moves forward, leaving every ply on the way computed for sibling nodes to reuse
+        for (int i = from + 1; i <= ply; i++) {
+            update_perspective(stack[i - 1], stack[i], dirty[i], perspective);
+        }
+    }
+}
+
+int Network::evaluate(const Accumulator& acc, bool white_to_move) const {
+    alignas(64) uint8_t ft_out[2 * L1];
+    alignas(64) int32_t l2_raw[L2];
+    alignas(64) uint8_t l2_out[L2];
+    alignas(64) int32_t l3_raw[L3];
+    alignas(64) uint8_t l3_out[L3];
+    int32_t output;
+
+    int us = white_to_move ? WHITE : BLACK;
+    clip_accumulator(acc.values[us], ft_out);
+    clip_accumulator(acc.values[us ^ 1], ft_out + L1);
+
+    affine(ft_out, 2 * L1, l2_weights, l2_biases, l2_raw, L2);
+    activate(l2_raw, l2_out, L2);
+    affine(l2_out, L2, l3_weights, l3_biases, l3_raw, L3);
+    activate(l3_raw, l3_out, L3);
+    affine(l3_out, L3, out_weights, out_bias, &output, 1);
+
+    return output / OUTPUT_SCALE;
+}
+
+} // namespace nnue
@@ -0,0 +1,139 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "thc.h"
+#include "bitboard.h"
+#include <cstdint>
+#include <string>
+
+/*
+ *  nnue
+ *
+ *  Efficiently updatable neural network evaluation. The network has the following layers:
+ *
+ *      HalfKA features (x2 perspectives) -> L1 (int16 accumulator) -> L2 (int8) -> L3 (int8) -> 1
+ *
+ *  Every feature is (king bucket, piece, square) seen from one side's point of view. The board is flipped
+ *  for Black and mirrored so the own king is always on files a-d. Since a move only touches a few pieces,
+ *  the first layer (the accumulator) is updated by adding/subtracting a few weight rows instead of being
+ *  recomputed. Only when a king changes bucket (or side of the board) does that perspective get rebuilt.
+ *
+ *  Updates are lazy: making a move only records which pieces changed, and the accumulator is brought up to
+ *  date when the position is actually evaluated, starting from the nearest ply that was already computed.
+ */
+
+namespace nnue {
+
+constexpr int KING_BUCKETS = 8;
+constexpr int PIECE_SQUARES = 12 * 64;
+constexpr int INPUT_DIMS = KING_BUCKETS * PIECE_SQUARES;
+constexpr int L1 = 256;
+constexpr int L2 = 32;
+constexpr int L3 = 32;
+
+constexpr int WEIGHT_SCALE_BITS = 6;   // Dense layer outputs are shifted down by this before clipping
+constexpr int OUTPUT_SCALE = 16;       // Network output / OUTPUT_SCALE = centipawns
+
+enum Perspective { WHITE = 0, BLACK = 1 };
+
+// First layer output for both perspectives
+struct alignas(64) Accumulator {
+    int16_t values[2][L1];
+    bool computed[2];       // values[perspective] is up to date
+};
+
+// Accumulators cached per perspective and king slot, together with the pieces they were computed for
+// ("Finny tables"). When a king changes bucket, the new accumulator is the cached one for that bucket plus
+// the difference between the cached pieces and the current ones, instead of a rebuild from scratch.
+// Each search thread owns one, Network::reset_cache prepares it for the loaded net.
+struct RefreshCache {
+    struct alignas(64) Entry {
+        int16_t values[L1];
+        Bitboard pieces[12];    // PNBRQKpnbrqk
+    };
+    Entry entries[2][2 * KING_BUCKETS];
+};
+
+// Pieces removed and added by a single move. Castling is the worst case with 2 of each.
+struct DirtyPieces {
+    int removed_count = 0;
+    int added_count = 0;
+    char removed_piece[2];
+    int removed_square[2];
+    char added_piece[2];
+    int added_square[2];
+    int king_square[2];     // King squares after the move, by perspective
+};
+
+// Squares a move can change: src, dst and the rook (castling) or captured pawn (en passant) squares.
+// Returns how many were written to out.
+int touched_squares(const thc::Move& move, int out[4]);
+
+// Build the dirty piece list by comparing the touched squares before and after the move
+DirtyPieces diff_squares(const int touched[], const char before[], int count, const thc::ChessRules& after);
+
+// Bucket (including the mirror bit) of a perspective's king. Accumulators stay valid while it doesn't change.
+int king_slot(int king_square, int perspective);
+
+// Feature index of piece on square for the given perspective
+int feature_index(int perspective, int king_square, char piece, int square);
+
+// The move moved this perspective's king to another slot, so its features can't be updated incrementally
+bool needs_refresh(const DirtyPieces& dirty, int perspective);
+
+class Network {
+public:
+    Network();
+    ~Network();
+
+    Network(const Network&) = delete;
+    Network& operator=(const Network&) = delete;
+
+    // Map a network file read-only and use it in place. Returns false on error, the network loaded before
+    // (if any) then stays in use.
+    bool load(const std::string& path);
+    bool is_loaded() const { return storage != nullptr; }
+
+    // Reset every cache entry to the empty board
+    void reset_cache(RefreshCache& cache) const;
+
+    // Rebuild the accumulator from the board, from scratch or as a diff against the refresh cache
+    void refresh(const thc::ChessRules& cr, Accumulator& acc) const;
+    void refresh(const thc::ChessRules& cr, Accumulator& acc, RefreshCache& cache) const;
+    void refresh_perspective(const thc::ChessRules& cr, Accumulator& acc, int perspective) const;
+    void refresh_perspective(const thc::ChessRules& cr, Accumulator& acc, int perspective,
+                             RefreshCache& cache) const;
+
+    // Compute one perspective of the accumulator after a move from the one before it
+    void update_perspective(const Accumulator& prev, Accumulator& next, const DirtyPieces& dirty,
+                            int perspective) const;
+
+    // Bring stack[ply] up to date. stack[i] is the accumulator i plies below the root (stack[0] must be
+    // computed), dirty[i] the move that led to it and cr the position at ply. Each perspective is replayed
+    // from the nearest computed ancestor, or refreshed through the cache if a king changed slot on the way.
+    void update_lazy(Accumulator stack[], const DirtyPieces dirty[], int ply, const thc::ChessRules& cr,
+                     RefreshCache& cache) const;
+
+    // Score in centipawns from the side to move's point of view
+    int evaluate(const Accumulator& acc, bool white_to_move) const;
+
+private:
+    void release();
+
+    // The mapped network file, the pointers below point into it
+    const char* storage = nullptr;
+    size_t storage_size = 0;
+
+    const int16_t* ft_biases = nullptr;     // [L1]
+    const int16_t* ft_weights = nullptr;    // [INPUT_DIMS][L1]
+    const int32_t* l2_biases = nullptr;     // [L2]
+    const int8_t*  l2_weights = nullptr;    // [L2][2 * L1]
+    const int32_t* l3_biases = nullptr;     // [L3]
+    const int8_t*  l3_weights = nullptr;    // [L3][L2]
+    const int32_t* out_bias = nullptr;      // [1]
+    const int8_t*  out_weights = nullptr;   // [L3]
+};
+
+} // namespace nnue
+
+#endif // NNUE_H
@@ -0,0 +1,49 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <cerrno>
+#include <cstdlib>
+#include <type_traits>
+
+/*
+ *  options
+ *
+ *  Checked parsing of the numeric command-line values of the engine and the tools. A value has to be a
+ *  number and nothing else, in range for its type. The parsers return false instead of throwing like
+ *  std::stoi, so a bad value makes the caller print its usage.
+ */
+
+inline bool parse_int(const char* text, int& value) {
+    char* end;
+    errno = 0;
+    long parsed = std::strtol(text, &end, 10);
+    value = int(parsed);
+    return end != text && *end == '\0' && errno == 0 && parsed == value;
+}
+
+// Counts and seeds (size_t, uint64_t), a minus sign is rejected rather than wrapped around like strtoull does
+template <typename T>
+bool parse_unsigned(const char* text, T& value) {
+    static_assert(std::is_unsigned<T>::value, "parse_unsigned needs an unsigned type");
+    char* end;
+    errno = 0;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    value = T(parsed);
+    return end != text && *end == '\0' && errno == 0 && text[0] != '-' && parsed == value;
+}
+
+inline bool parse_float(const char* text, float& value) {
+    char* end;
+    errno = 0;
+    value = std::strtof(text, &end);
+    return end != text && *end == '\0' && errno == 0;
+}
+
+inline bool parse_double(const char* text, double& value) {
+    char* end;
+    errno = 0;
+    value = std::strtod(text, &end);
+    return end != text && *end == '\0' && errno == 0;
+}
+
+#endif // OPTIONS_H
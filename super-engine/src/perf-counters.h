@@ -0,0 +1,242 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+/*
+ *  perf-counters
+ *
+ *  Hardware counter profile of the search phases: cycles, instructions, L1D and last level cache read
+ *  misses, branch misses and CPU time, read with Linux perf_event_open for the calling thread (user space
+ *  only) and charged to whichever phase was running. Build with
+ *
+ *      make clean && make PERF_COUNTERS=1
+ *
+ *  to enable it. Otherwise the PERF_* macros expand to nothing and none of this is compiled in.
+ *
+ *      PERF_PHASE(TT);             the rest of the enclosing block counts as TT, the previous phase after it
+ *      PERF_SWITCH(MOVEGEN);       from here on the current PERF_PHASE block counts as MOVEGEN
+ *
+ *  Phases are exclusive: time spent in a nested phase (a child node's search, an eval) is not charged to
+ *  the outer one. The counters are read at every phase change, one read() for the whole group, which
+ *  slows the search down several times, so compare phases against each other and not against normal
+ *  builds. Counters the kernel won't open (no PMU in a VM, perf_event_paranoid) are left out and shown as
+ *  "-"; if none open at all the profile just says so. SerialEngine::solve prints it after each search.
+ */
+
+#ifdef PERF_COUNTERS
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace perf_counters {
+
+enum Phase { SEARCH, TT, MOVEGEN, ORDERING, MAKE_UNMAKE, EVAL, QUIESCE, PHASE_COUNT, NO_PHASE = PHASE_COUNT };
+
+constexpr const char* PHASE_NAMES[PHASE_COUNT] = {
+    "search", "tt", "movegen", "ordering", "make/unmake", "eval", "quiesce"
+};
+
+enum Counter { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, BRANCH_MISSES, TASK_CLOCK, COUNTER_COUNT };
+
+struct CounterConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t cache_read_misses(uint64_t cache) {
+    return cache | uint64_t(PERF_COUNT_HW_CACHE_OP_READ) << 8 | uint64_t(PERF_COUNT_HW_CACHE_RESULT_MISS) << 16;
+}
+
+// Hardware counters first, a software group leader would keep them from joining on some kernels
+constexpr CounterConfig COUNTER_CONFIGS[COUNTER_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, cache_read_misses(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HW_CACHE, cache_read_misses(PERF_COUNT_HW_CACHE_LL)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+};
+
+class Profile {
+public:
+    ~Profile() { close(); }
+
+    // Open the counters (once) and zero the totals, false if no counter could be opened
+    bool start() {
+        if (!opened) {
+            open();
+        }
+        std::memset(totals, 0, sizeof(totals));
+        phase = NO_PHASE;
+        read_group(last);
+        return leader >= 0;
+    }
+
+    // Charge what was counted since the last change to the running phase and make p the running one
+    Phase switch_to(Phase p) {
+        Phase previous = phase;
+        if (leader >= 0) {
+            uint64_t now[COUNTER_COUNT];
+            read_group(now);
+            if (previous != NO_PHASE) {
+                for (int c = 0; c < COUNTER_COUNT; c++) {
+                    totals[previous][c] += now[c] - last[c];
+                }
+            }
+            std::memcpy(last, now, sizeof(last));
+        }
+        phase = p;
+        return previous;
+    }
+
+    // One row per phase that ran: share of the CPU time, IPC and misses per search node
+    void print(std::ostream& out, uint64_t nodes) const {
+        if (leader < 0) {
+            out << "perf counters: unavailable (perf_event_open failed)" << std::endl;
+            return;
+        }
+        uint64_t total_clock = 0;
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            total_clock += totals[p][TASK_CLOCK];
+        }
+        double per_node = nodes ? 1.0 / nodes : 0.0;
+        out << std::left << std::setw(13) << "phase" << std::right << std::setw(10) << "ms" << std::setw(8) << "time %"
+            << std::setw(7) << "IPC" << std::setw(12) << "cycles/node" << std::setw(12) << "L1D/node"
+            << std::setw(12) << "LLC/node" << std::setw(14) << "br miss/node" << "\n";
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            const uint64_t* t = totals[p];
+            if (t[TASK_CLOCK] == 0 && t[CYCLES] == 0) {
+                continue;
+            }
+            out << std::left << std::setw(13) << PHASE_NAMES[p] << std::right << std::fixed << std::setprecision(1);
+            column(out, 10, TASK_CLOCK, t[TASK_CLOCK] / 1e6);
+            column(out, 8, TASK_CLOCK, total_clock ? 100.0 * t[TASK_CLOCK] / total_clock : 0.0);
+            out << std::setprecision(2);
+            if (available[CYCLES] && available[INSTRUCTIONS] && t[CYCLES]) {
+                out << std::setw(7) << double(t[INSTRUCTIONS]) / t[CYCLES];
+            } else {
+                out << std::setw(7) << "-";
+            }
+            column(out, 12, CYCLES, t[CYCLES] * per_node);
+            column(out, 12, L1D_MISSES, t[L1D_MISSES] * per_node);
+            column(out, 12, LLC_MISSES, t[LLC_MISSES] * per_node);
+            column(out, 14, BRANCH_MISSES, t[BRANCH_MISSES] * per_node);
+            out << "\n";
+        }
+        out << "nodes: " << nodes;
+        if (!available[CYCLES]) {
+            out << " (no hardware counters, only CPU time)";
+        }
+        out << std::endl;
+        out.unsetf(std::ios::floatfield);
+    }
+
+private:
+    int fds[COUNTER_COUNT] = {-1, -1, -1, -1, -1, -1};
+    bool available[COUNTER_COUNT] = {};
+    int slot[COUNTER_COUNT] = {};       // Position in the group read
+    int leader = -1;
+    int members = 0;
+    bool opened = false;
+    Phase phase = NO_PHASE;
+    uint64_t last[COUNTER_COUNT] = {};
+    uint64_t totals[PHASE_COUNT][COUNTER_COUNT] = {};
+
+    void open() {
+        opened = true;
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = COUNTER_CONFIGS[c].type;
+            attr.config = COUNTER_CONFIGS[c].config;
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.disabled = leader < 0;
+            int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                continue;
+            }
+            if (leader < 0) {
+                leader = fd;
+            }
+            fds[c] = fd;
+            available[c] = true;
+            slot[c] = members++;
+        }
+        if (leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    void close() {
+        for (int& fd : fds) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            fd = -1;
+        }
+        leader = -1;
+    }
+
+    // The group as {nr, values...}, unopened counters read 0
+    void read_group(uint64_t values[COUNTER_COUNT]) const {
+        uint64_t buffer[1 + COUNTER_COUNT] = {};
+        if (leader >= 0 && ::read(leader, buffer, sizeof(buffer)) < 0) {
+            std::memset(buffer, 0, sizeof(buffer));
+        }
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            values[c] = available[c] ? buffer[1 + slot[c]] : 0;
+        }
+    }
+
+    void column(std::ostream& out, int width, Counter c, double value) const {
+        if (available[c]) {
+            out << std::setw(width) << value;
+        } else {
+            out << std::setw(width) << "-";
+        }
+    }
+};
+
+// Counters are per thread, so is the profile
+inline thread_local Profile profile;
+
+class PhaseScope {
+public:
+    explicit PhaseScope(Phase p) : previous(profile.switch_to(p)) {}
+    ~PhaseScope() { profile.switch_to(previous); }
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+
+private:
+    Phase previous;
+};
+
+} // namespace perf_counters
+
+#define PERF_CONCAT2(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT2(a, b)
+#define PERF_PHASE(phase) perf_counters::PhaseScope PERF_CONCAT(perf_phase_, __LINE__)(perf_counters::phase)
+#define PERF_SWITCH(phase) perf_counters::profile.switch_to(perf_counters::phase)
+#define PERF_START() perf_counters::profile.start()
+#define PERF_PRINT(out, nodes) perf_counters::profile.print(out, nodes)
+
+#else
+
+#define PERF_PHASE(phase) ((void)0)
+#define PERF_SWITCH(phase) ((void)0)
+#define PERF_START() ((void)0)
+#define PERF_PRINT(out, nodes) ((void)0)
+
+#endif // PERF_COUNTERS
+
+#endif // PERF_COUNTERS_H
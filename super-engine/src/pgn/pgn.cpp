@@ -0,0 +1,299 @@
+#include "pgn.h"
+#include "search-trace.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pgn {
+
+namespace {
+
+bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Start of the first game at or after from: a '[' at the start of a line that follows a blank line
+size_t next_game(const char* data, size_t size, size_t from) {
+    for (size_t i = from; i < size; i++) {
+        if (data[i] != '\n') {
+            continue;
+        }
+        size_t j = i + 1;
+        while (j < size && data[j] == '\r') {
+            j++;
+        }
+        if (j < size && data[j] == '\n') {
+            while (j < size && is_space(data[j])) {
+                j++;
+            }
+            if (j < size && data[j] == '[') {
+                return j;
+            }
+        }
+    }
+    return size;
+}
+
+// Value of the tag starting at p ("[Name "Value"]"), empty if malformed
+std::string_view tag_value(const char* p, const char* end) {
+    const char* open = static_cast<const char*>(std::memchr(p, '"', end - p));
+    const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    line_end = line_end ? line_end : end;
+    if (!open || open > line_end) {
+        return {};
+    }
+    const char* close = open + 1;
+    while (close < line_end && *close != '"') {
+        close += *close == '\\' && close + 1 < line_end ? 2 : 1;
+    }
+    return close < line_end ? std::string_view(open + 1, close - open - 1) : std::string_view();
+}
+
+// Reads the games of one chunk
+class ChunkParser {
+public:
+    ChunkParser(const char* data, const char* begin, const char* end, Visitor& visitor, const Options& options, Stats& stats)
+        : data(data), p(begin), end(end), visitor(visitor), options(options), stats(stats) {}
+
+    void run() {
+        while (skip_space(), p < end) {
+            if (*p == '[') {
+                game();
+            } else {
+                skip_line();    // Move text without tags, or junk
+            }
+        }
+    }
+
+private:
+    void skip_space() {
+        while (p < end && is_space(*p)) {
+            p++;
+        }
+    }
+
+    void skip_line() {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        p = nl ? nl + 1 : end;
+    }
+
+    bool at_line_start() const {
+        return p[-1] == '\n';
+    }
+
+    void game() {
+        GameHeader header;
+        const char* tags_begin = p;
+        header.offset = p - data;
+        while (p < end && *p == '[') {
+            if (std::strncmp(p, "[Result ", 8) == 0) {
+                header.result = tag_value(p, end);
+            } else if (std::strncmp(p, "[FEN ", 5) == 0) {
+                header.fen = tag_value(p, end);
+            }
+            skip_line();
+            skip_space();
+        }
+        header.tags = std::string_view(tags_begin, p - tags_begin);
+
+        thc::ChessRules cr;
+        bool replayed = visitor.begin_game(header);
+        bool active = replayed;
+        bool complete = true;
+        if (active && !header.fen.empty()) {
+            std::string fen(header.fen);
+            complete = active = replayed = cr.Forsyth(fen.c_str());
+        }
+
+        // Move text, up to the next tag at the start of a line outside comments
+        int variation = 0;
+        while (p < end) {
+            char c = *p;
+            if (c == '[' && at_line_start()) {
+                break;
+            }
+            if (c == '{') {
+                const char* close = static_cast<const char*>(std::memchr(p, '}', end - p));
+                p = close ? close + 1 : end;
+                continue;
+            }
+            if (c == ';' || (c == '%' && at_line_start())) {
+                skip_line();
+                continue;
+            }
+            if (c == '(' || c == ')') {
+                variation += c == '(' ? 1 : -1;
+                p++;
+                continue;
+            }
+            if (is_space(c)) {
+                p++;
+                continue;
+            }
+
+            const char* token = p;
+            while (p < end && !is_space(*p) && !std::strchr("{;()", *p)) {
+                p++;
+            }
+            std::string_view t(token, p - token);
+            if (!active || variation > 0 || t[0] == '$') {
+                continue;
+            }
+            if (t == "1-0" || t == "0-1" || t == "1/2-1/2" || t == "*") {
+                active = false;
+                continue;
+            }
+
+            // Move number in front ("12." or "12..."), a bare number is skipped
+            size_t digits = t.find_first_not_of("0123456789");
+            if (digits == std::string_view::npos) {
+                continue;
+            }
+            if (digits > 0 && t[digits] == '.') {
+                size_t start = t.find_first_not_of('.', digits);
+                if (start == std::string_view::npos) {
+                    continue;
+                }
+                t.remove_prefix(start);
+            }
+
+            thc::Move move;
+            if (!san_to_move(cr, t, move, options.fast_san)) {
+                complete = active = false;
+                continue;
+            }
+            stats.moves++;
+            if (!visitor.move(cr, move)) {
+                active = false;
+                continue;
+            }
+            cr.PlayMove(move);
+        }
+
+        stats.games++;
+        stats.bad_games += !complete;
+        if (replayed) {
+            visitor.final_position(cr);
+        }
+        visitor.end_game(complete);
+    }
+
+    const char* data;
+    const char* p;
+    const char* end;
+    Visitor& visitor;
+    const Options& options;
+    Stats& stats;
+};
+
+} // namespace
+
+std::string_view GameHeader::tag(std::string_view name) const {
+    const char* p = tags.data();
+    const char* end = p + tags.size();
+    while (p < end) {
+        if (*p == '[' && size_t(end - p) > name.size() + 1 && tags.compare(p + 1 - tags.data(), name.size(), name) == 0
+            && p[name.size() + 1] == ' ') {
+            return tag_value(p, end);
+        }
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        p = nl ? nl + 1 : end;
+    }
+    return {};
+}
+
+bool san_to_move(thc::ChessRules& cr, std::string_view san, thc::Move& move, bool fast) {
+    // Annotations and check marks aren't part of the move, castling may be written with zeros
+    char buf[16];
+    while (!san.empty() && std::strchr("!?+#", san.back())) {
+        san.remove_suffix(1);
+    }
+    if (san.empty() || san.size() >= sizeof(buf)) {
+        return false;
+    }
+    for (size_t i = 0; i < san.size(); i++) {
+        buf[i] = san[0] == '0' && san[i] == '0' ? 'O' : san[i];
+    }
+    buf[san.size()] = '\0';
+
+    if (fast && buf[0] != 'O' && move.NaturalInFast(&cr, buf)) {
+        bool white = cr.white;
+        cr.PushMove(move);
+        bool legal = !cr.AttackedSquare(white ? cr.wking_square : cr.bking_square, !white);
+        cr.PopMove(move);
+        if (legal) {
+            return true;
+        }
+    }
+    return move.NaturalIn(&cr, buf);
+}
+
+bool parse_file(const std::string& path, const std::vector<Visitor*>& visitors, const Options& options, Stats& stats) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    if (size == 0 || visitors.empty()) {
+        close(fd);
+        return true;
+    }
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+    madvise(base, size, MADV_SEQUENTIAL);
+    const char* data = static_cast<const char*>(base);
+
+    // Chunk boundaries are found up front, only the bytes after each nominal boundary are scanned
+    std::vector<size_t> starts {0};
+    while (starts.back() < size) {
+        size_t from = starts.back() + std::max<size_t>(options.chunk_size, 1);
+        starts.push_back(from >= size ? size : next_game(data, size, from));
+    }
+
+    std::atomic<size_t> next_chunk {0};
+    std::mutex stats_mutex;
+    auto worker = [&](Visitor* visitor) {
+        SEARCH_TRACE_THREAD_NAME("pgn reader");
+        Stats local;
+        for (size_t c = next_chunk++; c + 1 < starts.size(); c = next_chunk++) {
+            SEARCH_TRACE_SCOPE("pgn chunk", "chunk", int64_t(c));
+            ChunkParser(data, data + starts[c], data + starts[c + 1], *visitor, options, local).run();
+        }
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        stats.games += local.games;
+        stats.bad_games += local.bad_games;
+        stats.moves += local.moves;
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < visitors.size(); t++) {
+        threads.emplace_back(worker, visitors[t]);
+    }
+    worker(visitors[0]);
+    {
+        SEARCH_TRACE_SCOPE("wait for readers");
+        for (std::thread& t : threads) {
+            t.join();
+        }
+    }
+    stats.bytes += size;
+
+    munmap(base, size);
+    return true;
+}
+
+} // namespace pgn
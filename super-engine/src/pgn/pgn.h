@@ -0,0 +1,74 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include "thc.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ *  pgn
+ *
+ *  Streaming PGN reader. The file is mapped read-only and cut into chunks of about chunk_size bytes that
+ *  end on a game boundary (a blank line followed by a tag). Threads take chunks in turn and replay their
+ *  games, reporting every move with the position before it to their own Visitor, so visitors need no
+ *  locking.
+ *
+ *  Moves are matched with thc's NaturalInFast, which only looks at the pieces that can reach the
+ *  destination square, plus a king safety check. Castling and anything the fast path can't read go
+ *  through NaturalIn, which checks against the full legal move list.
+ */
+
+namespace pgn {
+
+struct GameHeader {
+    std::string_view tags;      // The tag section as in the file
+    std::string_view result;    // Value of the Result tag, empty without one
+    std::string_view fen;       // Value of the FEN tag, empty for the standard start position
+    uint64_t offset = 0;        // Of the first tag in the file
+
+    // Value of any tag, empty if the game doesn't have it
+    std::string_view tag(std::string_view name) const;
+};
+
+class Visitor {
+public:
+    virtual ~Visitor() = default;
+
+    // Start of a game, false skips it
+    virtual bool begin_game(const GameHeader& /*header*/) { return true; }
+
+    // A move of the main line and the position it is played in, false skips the rest of the game
+    virtual bool move(const thc::ChessRules& position, const thc::Move& move) = 0;
+
+    // The last position of the main line that was replayed, before end_game. Not called for skipped games
+    // or a FEN that can't be read.
+    virtual void final_position(const thc::ChessRules& /*position*/) {}
+
+    // End of a game, complete is false when it stopped at a move that couldn't be read or played
+    virtual void end_game(bool /*complete*/) {}
+};
+
+struct Options {
+    size_t chunk_size = 4 << 20;
+    bool fast_san = true;       // False matches every move with NaturalIn, for comparison
+};
+
+struct Stats {
+    uint64_t games = 0;
+    uint64_t bad_games = 0;
+    uint64_t moves = 0;
+    uint64_t bytes = 0;
+};
+
+// Parse a file with one thread per visitor (visitors[i] is only called from thread i). Stats are added
+// to. False if the file can't be mapped.
+bool parse_file(const std::string& path, const std::vector<Visitor*>& visitors, const Options& options, Stats& stats);
+
+// Match one SAN move ("Nbd7", "exd8=Q+", "O-O") in a position
+bool san_to_move(thc::ChessRules& cr, std::string_view san, thc::Move& move, bool fast = true);
+
+} // namespace pgn
+
+#endif // PGN_H
@@ -0,0 +1,227 @@
+#include "indexer.h"
+#include "posindex.h"
+#include "polyglot.h"
+#include "pgn.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace posindex {
+
+namespace {
+
+constexpr size_t RECORDS_PER_READ = 4096;
+
+class Indexer {
+public:
+    Indexer(const IndexerOptions& options, IndexerStats& stats) : options(options), stats(stats) {}
+
+    bool run(const std::vector<std::string>& pgn_files, const std::string& output) {
+        int threads = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        size_t limit = std::max<size_t>(options.max_entries / threads, RECORDS_PER_READ);
+        std::vector<std::unique_ptr<IndexVisitor>> visitors;
+        std::vector<pgn::Visitor*> pointers;
+        for (int t = 0; t < threads; t++) {
+            visitors.push_back(std::make_unique<IndexVisitor>(*this, limit));
+            pointers.push_back(visitors.back().get());
+        }
+
+        bool ok = true;
+        pgn::Stats read;
+        std::vector<SourceFile> sources;
+        uint64_t base = 0;
+        for (const std::string& file : pgn_files) {
+            for (auto& v : visitors) {
+                v->base = base;
+            }
+            struct stat st;
+            if (stat(file.c_str(), &st) != 0 || !pgn::parse_file(file, pointers, pgn::Options(), read)) {
+                message("cannot read " + file);
+                ok = false;
+                break;
+            }
+            sources.push_back(SourceFile {file, uint64_t(st.st_size)});
+            base += st.st_size;
+        }
+        for (auto& v : visitors) {
+            ok = spill(v->records) && ok;
+        }
+        stats.games = read.games;
+        stats.bad_games = read.bad_games;
+
+        ok = ok && merge(sources, output);
+        for (const std::string& run : runs) {
+            std::remove(run.c_str());
+        }
+        return ok;
+    }
+
+private:
+    void message(const std::string& text) {
+        if (options.log) {
+            *options.log << text << std::endl;
+        }
+    }
+
+    // Collects a record for every position of the main line, spilled as a run when it holds limit of them
+    class IndexVisitor : public pgn::Visitor {
+    public:
+        IndexVisitor(Indexer& indexer, size_t limit) : indexer(indexer), limit(limit) {}
+
+        bool begin_game(const pgn::GameHeader& header) override {
+            game = base + header.offset;
+            ply = 0;
+            return true;
+        }
+
+        bool move(const thc::ChessRules& position, const thc::Move&) override {
+            records.push_back(make_record(book::key(position), game, ply++));
+            return true;
+        }
+
+        void final_position(const thc::ChessRules& position) override {
+            records.push_back(make_record(book::key(position), game, ply));
+        }
+
+        void end_game(bool) override {
+            if (records.size() >= limit) {
+                indexer.spill(records);
+            }
+        }
+
+        uint64_t base = 0;              // Of the file being read, in the files taken one after another
+        std::vector<Record> records;
+
+    private:
+        Indexer& indexer;
+        size_t limit;
+        uint64_t game = 0;
+        int ply = 0;
+    };
+
+    // Sort the records and write them as a run, called from the reader threads
+    bool spill(std::vector<Record>& records) {
+        if (records.empty()) {
+            return true;
+        }
+        std::sort(records.begin(), records.end());
+        std::string path = options.temp_dir + "/indexgen-" + std::to_string(getpid()) + "-"
+                           + std::to_string(next_run++) + ".run";
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        runs.push_back(path);
+        stats.positions += records.size();
+        records.clear();
+        if (!out) {
+            write_failed = true;
+            message("cannot write " + path);
+            return false;
+        }
+        stats.runs++;
+        return true;
+    }
+
+    // k-way merge of the runs into the index
+    bool merge(const std::vector<SourceFile>& sources, const std::string& output) {
+        if (write_failed) {
+            return false;
+        }
+
+        std::ofstream out(output, std::ios::binary | std::ios::trunc);
+        FileHeader header {};
+        std::memcpy(header.magic, "POSX", 4);
+        header.version = FILE_VERSION;
+        header.records = stats.positions;
+        header.files = sources.size();
+        std::string table;
+        for (const SourceFile& f : sources) {
+            uint32_t length = f.path.size();
+            table.append(reinterpret_cast<const char*>(&f.size), 8);
+            table.append(reinterpret_cast<const char*>(&length), 4);
+            table += f.path;
+        }
+        table.resize((sizeof(FileHeader) + table.size() + sizeof(Record) - 1) / sizeof(Record) * sizeof(Record)
+                     - sizeof(FileHeader), '\0');
+        header.records_offset = sizeof(FileHeader) + table.size();
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(table.data(), table.size());
+
+        // Each run is read a block at a time
+        struct Source {
+            std::ifstream in;
+            std::vector<Record> block;
+            size_t at = 0;
+            const Record& record() const { return block[at]; }
+            bool next() {
+                if (++at < block.size()) {
+                    return true;
+                }
+                block.resize(RECORDS_PER_READ);
+                in.read(reinterpret_cast<char*>(block.data()), RECORDS_PER_READ * sizeof(Record));
+                block.resize(in.gcount() / sizeof(Record));
+                at = 0;
+                return !block.empty();
+            }
+        };
+        std::vector<std::unique_ptr<Source>> inputs;
+        auto later = [&](size_t a, size_t b) { return inputs[b]->record() < inputs[a]->record(); };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(later)> heap(later);
+        for (const std::string& run : runs) {
+            inputs.push_back(std::make_unique<Source>());
+            inputs.back()->in.open(run, std::ios::binary);
+            if (inputs.back()->next()) {
+                heap.push(inputs.size() - 1);
+            }
+        }
+
+        std::vector<Record> block;
+        block.reserve(RECORDS_PER_READ);
+        while (!heap.empty()) {
+            size_t s = heap.top();
+            heap.pop();
+            block.push_back(inputs[s]->record());
+            if (block.size() == RECORDS_PER_READ) {
+                out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(Record));
+                block.clear();
+            }
+            if (inputs[s]->next()) {
+                heap.push(s);
+            }
+        }
+        out.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(Record));
+
+        if (!out) {
+            message("cannot write " + output);
+            return false;
+        }
+        return true;
+    }
+
+    const IndexerOptions& options;
+    IndexerStats& stats;
+    std::mutex mutex;
+    std::vector<std::string> runs;
+    std::atomic<uint64_t> next_run {0};
+    bool write_failed = false;
+};
+
+} // namespace
+
+bool build_index(const std::vector<std::string>& pgn_files, const std::string& output,
+                 const IndexerOptions& options, IndexerStats& stats) {
+    Indexer indexer(options, stats);
+    return indexer.run(pgn_files, output);
+}
+
+} // namespace posindex
@@ -0,0 +1,42 @@
+#ifndef POSINDEX_INDEXER_H
+#define POSINDEX_INDEXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ *  position index builder
+ *
+ *  Builds a position index (see posindex.h) from PGN files. The pgn reader's threads replay the games and
+ *  each collects a record for every position of the main line, the start and final positions included.
+ *  When a thread holds its share of max_entries records it sorts them and writes them to a run file in
+ *  temp_dir, so memory stays bounded however large the database. At the end the runs are merged into
+ *  the index.
+ */
+
+namespace posindex {
+
+struct IndexerOptions {
+    int threads = 0;                    // Reader threads, 0 for one per hardware thread
+    size_t max_entries = 1 << 24;       // Records held in memory by all threads before spilling runs
+    std::string temp_dir = "/tmp";
+    std::ostream* log = nullptr;
+};
+
+struct IndexerStats {
+    uint64_t games = 0;
+    uint64_t bad_games = 0;             // Stopped at an illegal or unreadable move, the plies before it count
+    uint64_t positions = 0;             // Records written to the index
+    uint64_t runs = 0;
+};
+
+// Build the index in output from the PGN files, false on an I/O error
+bool build_index(const std::vector<std::string>& pgn_files, const std::string& output,
+                 const IndexerOptions& options, IndexerStats& stats);
+
+} // namespace posindex
+
+#endif // POSINDEX_INDEXER_H
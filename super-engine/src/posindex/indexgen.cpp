@@ -0,0 +1,119 @@
+/*
+ *  indexgen
+ *
+ *  Builds a position index over PGN files (see posindex/indexer.h), and looks positions up in one.
+ *
+ *      make indexgen
+ *      ./indexgen -o games.idx [-j <threads>] [--max-entries N] [--temp <dir>] games.pgn...
+ *      ./indexgen -q games.idx [--limit N] "<fen>"
+ *
+ *  A lookup lists the games that reached the position with the ply it was reached at, the file and byte
+ *  offset of the game and its players.
+ */
+
+#include "indexer.h"
+#include "options.h"
+#include "posindex.h"
+#include "pgn.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Players and result from the tags of the game at offset
+std::string describe(const std::string& path, uint64_t offset) {
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(offset);
+    std::string tags, line;
+    while (std::getline(in, line) && !line.empty() && line[0] == '[') {
+        tags += line + "\n";
+    }
+    pgn::GameHeader header;
+    header.tags = tags;
+    return std::string(header.tag("White")) + " - " + std::string(header.tag("Black")) + " "
+           + std::string(header.tag("Result"));
+}
+
+int query(const std::string& index_path, const std::string& fen, size_t limit) {
+    posindex::PositionIndex index;
+    if (!index.open(index_path)) {
+        std::cerr << "Cannot open index " << index_path << std::endl;
+        return 1;
+    }
+    thc::ChessRules cr;
+    if (!cr.Forsyth(fen.c_str())) {
+        std::cerr << "Bad FEN: " << fen << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<posindex::Hit> hits = index.find(cr, limit);
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (const posindex::Hit& hit : hits) {
+        std::string path;
+        uint64_t offset;
+        if (index.locate(hit.game, path, offset)) {
+            std::cout << path << ":" << offset << " ply " << hit.ply << "  " << describe(path, offset) << std::endl;
+        }
+    }
+    std::cout << "Records: " << hits.size() << " of " << index.size() << ", Lookup: " << elapsed.count() << "us"
+              << std::endl;
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    posindex::IndexerOptions options;
+    options.log = &std::cerr;
+    std::string output, index;
+    size_t limit = 100;
+    std::vector<std::string> args;
+    bool usage = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "-q" && i + 1 < argc) {
+            index = argv[++i];
+        } else if (arg == "--limit" && i + 1 < argc && parse_unsigned(argv[i + 1], limit)) {
+            i++;
+        } else if (arg == "-j" && i + 1 < argc && parse_int(argv[i + 1], options.threads) && options.threads >= 0) {
+            i++;
+        } else if (arg == "--max-entries" && i + 1 < argc && parse_unsigned(argv[i + 1], options.max_entries)
+                   && options.max_entries > 0) {
+            i++;
+        } else if (arg == "--temp" && i + 1 < argc) {
+            options.temp_dir = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-') {
+            args.push_back(arg);
+        } else {
+            usage = true;
+        }
+    }
+    if (!index.empty() && output.empty() && args.size() == 1 && !usage) {
+        return query(index, args[0], limit);
+    }
+    if (usage || output.empty() || !index.empty() || args.empty()) {
+        std::cout << "Usage: " << argv[0] << " -o <index> [-j <threads>] [--max-entries <n>] [--temp <dir>] <pgn>...\n"
+                  << "       " << argv[0] << " -q <index> [--limit <n>] <fen>" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    posindex::IndexerStats stats;
+    bool ok = posindex::build_index(args, output, options, stats);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Games: " << stats.games << " (" << stats.bad_games << " with bad moves)"
+              << ", Positions: " << stats.positions
+              << ", Runs: " << stats.runs
+              << ", Time: " << elapsed.count() << "s"
+              << ", Games/s: " << (elapsed.count() > 0 ? stats.games / elapsed.count() : 0.0) << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include "posindex.h"
+#include "polyglot.h"
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace posindex {
+
+PositionIndex::~PositionIndex() {
+    close();
+}
+
+bool PositionIndex::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(FileHeader)) {
+        void* m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (m != MAP_FAILED) {
+            base = m;
+            mapped = st.st_size;
+        }
+    }
+    ::close(fd);
+    if (!base) {
+        return false;
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(base);
+    FileHeader header;
+    std::memcpy(&header, bytes, sizeof(header));
+    bool ok = std::memcmp(header.magic, "POSX", 4) == 0 && header.version == FILE_VERSION
+              && header.records_offset % sizeof(Record) == 0 && header.records_offset <= mapped
+              && header.records <= (mapped - header.records_offset) / sizeof(Record);
+
+    // Source files, between the header and the records
+    size_t at = sizeof(FileHeader);
+    for (uint64_t f = 0; ok && f < header.files; f++) {
+        uint64_t size;
+        uint32_t length;
+        if (at + 12 > header.records_offset) {
+            ok = false;
+            break;
+        }
+        std::memcpy(&size, bytes + at, 8);
+        std::memcpy(&length, bytes + at + 8, 4);
+        at += 12;
+        if (at + length > header.records_offset) {
+            ok = false;
+            break;
+        }
+        files.push_back(SourceFile {std::string(reinterpret_cast<const char*>(bytes + at), length), size});
+        at += length;
+    }
+
+    if (!ok) {
+        close();
+        return false;
+    }
+    records = reinterpret_cast<const Record*>(bytes + header.records_offset);
+    count = header.records;
+    madvise(base, mapped, MADV_RANDOM);
+    return true;
+}
+
+void PositionIndex::close() {
+    if (base) {
+        munmap(base, mapped);
+    }
+    base = nullptr;
+    mapped = 0;
+    records = nullptr;
+    count = 0;
+    files.clear();
+}
+
+uint64_t PositionIndex::lower_bound(uint64_t key) const {
+    uint64_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (records[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+std::vector<Hit> PositionIndex::find(uint64_t key, size_t limit) const {
+    std::vector<Hit> hits;
+    for (uint64_t i = lower_bound(key); i < count && records[i].key == key && hits.size() < limit; i++) {
+        hits.push_back(Hit {records[i].game_ply >> 16, int(records[i].game_ply & 0xFFFF)});
+    }
+    return hits;
+}
+
+std::vector<Hit> PositionIndex::find(const thc::ChessRules& cr, size_t limit) const {
+    return find(book::key(cr), limit);
+}
+
+uint64_t PositionIndex::count_of(uint64_t key) const {
+    uint64_t first = lower_bound(key);
+    uint64_t last = key == UINT64_MAX ? count : lower_bound(key + 1);
+    return last - first;
+}
+
+bool PositionIndex::locate(uint64_t game, std::string& path, uint64_t& offset) const {
+    for (const SourceFile& f : files) {
+        if (game < f.size) {
+            path = f.path;
+            offset = game;
+            return true;
+        }
+        game -= f.size;
+    }
+    return false;
+}
+
+} // namespace posindex
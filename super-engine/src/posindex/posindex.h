@@ -0,0 +1,102 @@
+#ifndef POSINDEX_H
+#define POSINDEX_H
+
+#include "thc.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ *  posindex
+ *
+ *  Index from positions to the games that reached them. The file holds a 64 byte header, the PGN files
+ *  the games were read from, and 16 byte records (position key, game, ply) sorted by key and game. The
+ *  key is the Polyglot key of the position (book::key), so transpositions and the en passant rule are
+ *  handled like in the opening books. A game is its byte offset in the PGN files taken one after another,
+ *  which locate() turns back into a file and an offset.
+ *
+ *  The file is mapped read-only and a position found by binary search over the records.
+ */
+
+namespace posindex {
+
+struct FileHeader {
+    char magic[4];              // "POSX"
+    uint32_t version;
+    uint64_t records;
+    uint64_t records_offset;    // Records start here, 16 byte aligned
+    uint64_t files;             // Each: size (8 bytes), name length (4 bytes), name, right after the header
+    uint8_t pad[32];
+};
+
+static_assert(sizeof(FileHeader) == 64, "index header must be 64 bytes");
+
+constexpr uint32_t FILE_VERSION = 1;
+
+// As stored: the game offset in the high 48 bits of game_ply, the ply in the low 16
+struct Record {
+    uint64_t key;
+    uint64_t game_ply;
+};
+
+static_assert(sizeof(Record) == 16, "index records must be 16 bytes");
+
+inline Record make_record(uint64_t key, uint64_t game, int ply) {
+    return Record {key, game << 16 | uint64_t(std::min(ply, 0xFFFF))};
+}
+
+inline bool operator<(const Record& a, const Record& b) {
+    return a.key != b.key ? a.key < b.key : a.game_ply < b.game_ply;
+}
+
+struct Hit {
+    uint64_t game;
+    int ply;                    // 0 for the position before the first move
+};
+
+struct SourceFile {
+    std::string path;
+    uint64_t size;
+};
+
+class PositionIndex {
+public:
+    PositionIndex() = default;
+    ~PositionIndex();
+    PositionIndex(const PositionIndex&) = delete;
+    PositionIndex& operator=(const PositionIndex&) = delete;
+
+    // Map an index file, replacing the current one. False (and no index) if it can't be mapped or isn't
+    // an index.
+    bool open(const std::string& path);
+    void close();
+    bool is_open() const { return records != nullptr; }
+
+    uint64_t size() const { return count; }
+    const std::vector<SourceFile>& sources() const { return files; }
+
+    // Games that reached a position, in game order, at most limit of them
+    std::vector<Hit> find(uint64_t key, size_t limit = SIZE_MAX) const;
+    std::vector<Hit> find(const thc::ChessRules& cr, size_t limit = SIZE_MAX) const;
+
+    // Number of records of a position (a game that repeats it counts more than once)
+    uint64_t count_of(uint64_t key) const;
+
+    // PGN file and byte offset of a game, false if it lies past the indexed files
+    bool locate(uint64_t game, std::string& path, uint64_t& offset) const;
+
+private:
+    // First record with a key not below key
+    uint64_t lower_bound(uint64_t key) const;
+
+    const Record* records = nullptr;
+    uint64_t count = 0;
+    void* base = nullptr;
+    size_t mapped = 0;
+    std::vector<SourceFile> files;
+};
+
+} // namespace posindex
+
+#endif // POSINDEX_H
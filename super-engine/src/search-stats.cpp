@@ -0,0 +1,76 @@
+#include "search-stats.h"
+#include <cmath>
+#include <sstream>
+
+SearchCounters& SearchCounters::operator+=(const SearchCounters& other) {
+    nodes += other.nodes;
+    qnodes += other.qnodes;
+    leaves += other.leaves;
+    tt_probes += other.tt_probes;
+    tt_hits += other.tt_hits;
+    tt_cutoffs += other.tt_cutoffs;
+    beta_cutoffs += other.beta_cutoffs;
+    for (int i = 0; i < CUTOFF_BUCKETS; i++) {
+        cutoffs_by_move[i] += other.cutoffs_by_move[i];
+    }
+    pawn_hash_probes += other.pawn_hash_probes;
+    pawn_hash_hits += other.pawn_hash_hits;
+    eval_probes += other.eval_probes;
+    eval_tt_hits += other.eval_tt_hits;
+    eval_cache_hits += other.eval_cache_hits;
+    evaluations += other.evaluations;
+    timed_evaluations += other.timed_evaluations;
+    timed_eval_seconds += other.timed_eval_seconds;
+    lazy_eval_calls += other.lazy_eval_calls;
+    lazy_eval_skips += other.lazy_eval_skips;
+    return *this;
+}
+
+double SearchStats::effective_branching_factor() const {
+    // Geometric mean of the growth from the first iteration with nodes to the last one
+    const Iteration* first = nullptr;
+    for (const Iteration& it : iterations) {
+        if (it.nodes > 0) {
+            first = &it;
+            break;
+        }
+    }
+    if (!first || iterations.back().depth <= first->depth || iterations.back().nodes == 0) {
+        return 0.0;
+    }
+    double growth = double(iterations.back().nodes) / first->nodes;
+    return std::pow(growth, 1.0 / (iterations.back().depth - first->depth));
+}
+
+std::string SearchStats::to_json() const {
+    const SearchCounters& c = counters;
+    std::ostringstream out;
+    out << "{\"depth\":" << (iterations.empty() ? 0 : iterations.back().depth)
+        << ",\"score\":" << (iterations.empty() ? 0.0f : iterations.back().score)
+        << ",\"seconds\":" << seconds
+        << ",\"nodes\":" << c.nodes
+        << ",\"qnodes\":" << c.qnodes
+        << ",\"leaves\":" << c.leaves
+        << ",\"nps\":" << (seconds > 0 ? uint64_t(c.nodes / seconds) : 0)
+        << ",\"ebf\":" << effective_branching_factor()
+        << ",\"tt\":{\"probes\":" << c.tt_probes << ",\"hits\":" << c.tt_hits << ",\"cutoffs\":" << c.tt_cutoffs << "}"
+        << ",\"beta_cutoffs\":" << c.beta_cutoffs
+        << ",\"cutoffs_by_move\":[";
+    for (int i = 0; i < SearchCounters::CUTOFF_BUCKETS; i++) {
+        out << (i ? "," : "") << c.cutoffs_by_move[i];
+    }
+    out << "],\"pawn_hash\":{\"probes\":" << c.pawn_hash_probes << ",\"hits\":" << c.pawn_hash_hits << "}"
+        << ",\"eval\":{\"probes\":" << c.eval_probes << ",\"tt_hits\":" << c.eval_tt_hits
+        << ",\"cache_hits\":" << c.eval_cache_hits << ",\"computed\":" << c.evaluations
+        << ",\"lazy_calls\":" << c.lazy_eval_calls << ",\"lazy_skips\":" << c.lazy_eval_skips << "}"
+        << ",\"tablebases\":{\"syzygy_probes\":" << tb_probes << ",\"syzygy_hits\":" << tb_hits
+        << ",\"egtb_probes\":" << egtb_probes << ",\"egtb_hits\":" << egtb_hits << "}"
+        << ",\"iterations\":[";
+    for (size_t i = 0; i < iterations.size(); i++) {
+        const Iteration& it = iterations[i];
+        out << (i ? "," : "") << "{\"depth\":" << it.depth << ",\"score\":" << it.score
+            << ",\"seconds\":" << it.seconds << ",\"nodes\":" << it.nodes << "}";
+    }
+    out << "]}";
+    return out.str();
+}
@@ -0,0 +1,70 @@
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ *  search-stats
+ *
+ *  Counters of one search thread. Each thread bumps its own SearchCounters, padded to whole cache lines
+ *  so threads never share one, and they are only added up when someone asks (SearchStats::add). Counters
+ *  are plain integers since no other thread writes them.
+ *
+ *  SearchStats is what a finished (or interrupted) search reports: the summed counters, one entry per
+ *  completed iteration and the tablebase probes, with to_json for tools that read it.
+ */
+
+struct alignas(64) SearchCounters {
+    static constexpr int CUTOFF_BUCKETS = 8;    // Cutoffs on move 1 ... 7, the last bucket the rest
+
+    uint64_t nodes = 0;                 // Positions searched, quiescence included
+    uint64_t qnodes = 0;                // Quiescence positions among them
+    uint64_t leaves = 0;                // Static evals at the horizon
+    uint64_t tt_probes = 0;
+    uint64_t tt_hits = 0;
+    uint64_t tt_cutoffs = 0;            // Nodes answered by the TT entry without searching
+    uint64_t beta_cutoffs = 0;
+    uint64_t cutoffs_by_move[CUTOFF_BUCKETS] = {};
+    uint64_t pawn_hash_probes = 0;
+    uint64_t pawn_hash_hits = 0;
+    uint64_t eval_probes = 0;           // Static evals asked of the TT entry and eval cache
+    uint64_t eval_tt_hits = 0;
+    uint64_t eval_cache_hits = 0;
+    uint64_t evaluations = 0;           // Static evals computed
+    uint64_t timed_evaluations = 0;     // Every EVAL_TIMING_INTERVAL-th evaluation is timed
+    double timed_eval_seconds = 0.0;
+    uint64_t lazy_eval_calls = 0;
+    uint64_t lazy_eval_skips = 0;
+
+    SearchCounters& operator+=(const SearchCounters& other);
+};
+
+struct SearchStats {
+    struct Iteration {
+        int depth;
+        float score;                    // Centipawns, White's point of view
+        double seconds;                 // Since the search started
+        uint64_t nodes;                 // In this iteration
+    };
+
+    SearchCounters counters;
+    std::vector<Iteration> iterations;
+    double seconds = 0.0;
+    uint64_t tb_probes = 0;
+    uint64_t tb_hits = 0;
+    uint64_t egtb_probes = 0;
+    uint64_t egtb_hits = 0;
+
+    // Add one thread's counters
+    void add(const SearchCounters& thread_counters) { counters += thread_counters; }
+
+    // Node growth per extra ply over the completed iterations, 0 with fewer than two
+    double effective_branching_factor() const;
+
+    // The stats as one line of JSON
+    std::string to_json() const;
+};
+
+#endif // SEARCH_STATS_H
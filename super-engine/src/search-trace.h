@@ -0,0 +1,224 @@
+#ifndef SEARCH_TRACE_H
+#define SEARCH_TRACE_H
+
+/*
+ *  search-trace
+ *
+ *  Timeline of what the threads were doing, written as Chrome trace JSON (load it in chrome://tracing or
+ *  ui.perfetto.dev). Build with
+ *
+ *      make clean && make SEARCH_TRACE=1
+ *
+ *  to enable it. Otherwise the SEARCH_TRACE_* macros expand to nothing and none of this is compiled in.
+ *
+ *      SEARCH_TRACE_OUTPUT("trace.json");                  written at exit and by SEARCH_TRACE_WRITE()
+ *      SEARCH_TRACE_THREAD_NAME("pgn reader");
+ *      SEARCH_TRACE_SCOPE("iteration", "depth", depth);    a span until the end of the enclosing block
+ *      SEARCH_TRACE_INSTANT("stop", "depth", depth);
+ *
+ *  Every thread records into its own ring buffer, the last RING_SIZE events, so recording takes no lock
+ *  and never allocates after a thread's first event. Spans are recorded when they end, as one complete
+ *  event, which keeps a wrapped ring free of unmatched begin/end pairs. Names must be string literals.
+ *  Buffers outlive their threads and are only read by the writer, which should run while the traced
+ *  threads are idle.
+ *
+ *  Recorded: searches, iterations, book moves, tablebase root filtering and time stops in SerialEngine,
+ *  PGN chunks taken by each reader thread, index blocks taken by each tablebase generator thread, and the
+ *  time the starting thread waits for the others to finish.
+ */
+
+#ifdef SEARCH_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace search_trace {
+
+constexpr uint64_t RING_SIZE = 1 << 16;
+
+struct Event {
+    const char* name;
+    const char* arg_name;       // nullptr for no argument
+    int64_t arg;
+    uint64_t start;             // Nanoseconds since the first traced event
+    uint64_t duration;          // Spans only
+    char phase;                 // 'X' span, 'i' instant
+};
+
+struct ThreadBuffer {
+    int tid = 0;
+    const char* name = nullptr;
+    std::atomic<uint64_t> written {0};
+    Event events[RING_SIZE];
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer*> unused;
+    std::string output;
+};
+
+inline Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+inline uint64_t now() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+// Buffers of finished threads are handed to new ones, so pools started over and over (tbgen starts one
+// per pass) keep to one buffer and one timeline row per worker
+struct BufferHolder {
+    ThreadBuffer* buffer = nullptr;
+
+    ~BufferHolder() {
+        if (buffer) {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            registry().unused.push_back(buffer);
+        }
+    }
+};
+
+// The calling thread's buffer, taken on its first event
+inline ThreadBuffer& local() {
+    thread_local BufferHolder holder;
+    if (!holder.buffer) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.unused.empty()) {
+            holder.buffer = r.unused.back();
+            r.unused.pop_back();
+        } else {
+            r.buffers.push_back(std::make_unique<ThreadBuffer>());
+            holder.buffer = r.buffers.back().get();
+            holder.buffer->tid = int(r.buffers.size());
+        }
+    }
+    return *holder.buffer;
+}
+
+inline void record(const Event& event) {
+    ThreadBuffer& b = local();
+    uint64_t n = b.written.load(std::memory_order_relaxed);
+    b.events[n % RING_SIZE] = event;
+    b.written.store(n + 1, std::memory_order_release);
+}
+
+inline void instant(const char* name, const char* arg_name = nullptr, int64_t arg = 0) {
+    record({name, arg_name, arg, now(), 0, 'i'});
+}
+
+class Scope {
+public:
+    explicit Scope(const char* name, const char* arg_name = nullptr, int64_t arg = 0)
+        : name(name), arg_name(arg_name), arg(arg), start(now()) {}
+    ~Scope() { record({name, arg_name, arg, start, now() - start, 'X'}); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name;
+    const char* arg_name;
+    int64_t arg;
+    uint64_t start;
+};
+
+inline void set_thread_name(const char* name) {
+    local().name = name;
+}
+
+// Every buffer's events as one Chrome trace file, false if it can't be written
+inline bool write(const std::string& path) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) {
+        return false;
+    }
+    std::fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    const char* separator = "";
+    for (const std::unique_ptr<ThreadBuffer>& b : r.buffers) {
+        if (b->name) {
+            std::fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                         separator, b->tid, b->name);
+            separator = ",\n";
+        }
+        uint64_t written = b->written.load(std::memory_order_acquire);
+        for (uint64_t i = written > RING_SIZE ? written - RING_SIZE : 0; i < written; i++) {
+            const Event& e = b->events[i % RING_SIZE];
+            std::fprintf(f, "%s{\"ph\":\"%c\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+                         separator, e.phase, e.name, b->tid, e.start / 1000.0);
+            if (e.phase == 'X') {
+                std::fprintf(f, ",\"dur\":%.3f", e.duration / 1000.0);
+            } else {
+                std::fprintf(f, ",\"s\":\"t\"");
+            }
+            if (e.arg_name) {
+                std::fprintf(f, ",\"args\":{\"%s\":%lld}", e.arg_name, static_cast<long long>(e.arg));
+            }
+            std::fprintf(f, "}");
+            separator = ",\n";
+        }
+    }
+    std::fprintf(f, "\n]}\n");
+    return std::fclose(f) == 0;
+}
+
+inline void write_output() {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        path = registry().output;
+    }
+    if (!path.empty() && !write(path)) {
+        std::fprintf(stderr, "Could not write trace %s\n", path.c_str());
+    }
+}
+
+// Where write_output puts the trace, which is also written at exit
+inline void set_output(const std::string& path) {
+    Registry& r = registry();
+    now();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.output.empty()) {
+        std::atexit(write_output);
+    }
+    r.output = path;
+}
+
+} // namespace search_trace
+
+// For options that only work in tracing builds
+constexpr bool SEARCH_TRACE_ENABLED = true;
+
+#define SEARCH_TRACE_CONCAT2(a, b) a##b
+#define SEARCH_TRACE_CONCAT(a, b) SEARCH_TRACE_CONCAT2(a, b)
+#define SEARCH_TRACE_SCOPE(...) search_trace::Scope SEARCH_TRACE_CONCAT(search_trace_scope_, __LINE__)(__VA_ARGS__)
+#define SEARCH_TRACE_INSTANT(...) search_trace::instant(__VA_ARGS__)
+#define SEARCH_TRACE_THREAD_NAME(name) search_trace::set_thread_name(name)
+#define SEARCH_TRACE_OUTPUT(path) search_trace::set_output(path)
+#define SEARCH_TRACE_WRITE() search_trace::write_output()
+
+#else
+
+constexpr bool SEARCH_TRACE_ENABLED = false;
+
+#define SEARCH_TRACE_SCOPE(...) ((void)0)
+#define SEARCH_TRACE_INSTANT(...) ((void)0)
+#define SEARCH_TRACE_THREAD_NAME(name) ((void)0)
+#define SEARCH_TRACE_OUTPUT(path) ((void)0)
+#define SEARCH_TRACE_WRITE() ((void)0)
+
+#endif // SEARCH_TRACE
+
+#endif // SEARCH_TRACE_H
@@ -15,7 +15,10 @@
  *  so on.
  * 
  * 
- *  Book (Unimplemented)
+ *  Book (Implemented, optional)
+ *
+ *  With --book <file>, solve() first looks the position up in a Polyglot book (book/) and plays one of its
+ *  moves, picked by weight, without searching. Only for the first --book-depth plies of the game.
  * 
  *  Search: 
  * 
@@ -42,7 +45,13 @@
  *                           ^                 /        |       |     \                                           
  *                          min              compute node B ... compute node E
  *  To do this we use piece square tables or heat maps as well as add bonuses for things like pawn structure, 
- *  king safety, etc. NNUE (unimplemented) is also used to adjust the scoring. 
+ *  king safety, etc. 
+ * 
+ *  NNUE (Implemented, optional)
+ * 
+ *  Instead of the hand-written evaluation, a small neural network (nnue/) can score the leaves. Its first layer is
+ *  kept per ply and updated incrementally: push_move only records the changed pieces and nnue_eval replays them
+ *  from the nearest computed ply, so nodes that are cut off before being evaluated cost nothing.
  * 
  *  Move reordering (Implemented)
  *  If we search branches with "important" moves first, this will greatly help with alpha-beta pruning. 
@@ -57,12 +66,29 @@
  *  To help speed up search, different transpositions that have already been scored should be stored in a hash map. This prevents
  *  needing to search the same position twice (DP).
  * 
- *  Syzygy (Unimplemented) 
+ *  Syzygy (Implemented, optional)
+ *
+ *  With --syzygy <dir>, positions with few enough pieces are looked up in Syzygy tablebases (syzygy/): the WDL
+ *  tables end the search right after a capture or pawn move into their range, and at the root the DTZ tables
+ *  drop every move that doesn't keep the best result. Only in builds with make SYZYGY=1 until the decoder
+ *  has been checked against real tables (make tbcheck).
+ *
+ *  With --egtb <dir>, the engine's own distance to mate tables (egtb/, built by tbgen) are used the same way
+ *  wherever Syzygy has no answer. Their wins are scored by mate distance, so the search heads for the
+ *  quickest mate.
  */
 
 
 #include "serial-engine.h"
+#include "mailbox.h"
+#include "eval-trace.h"
+#include "perf-counters.h"
+#include "search-trace.h"
+#include "kpk.h"
+#include "tbprobe.h"
+#include "egtb.h"
 #include <algorithm>
+#include <array>
 #include <map>
 #include <cctype>   
 #include <cmath>    
@@ -78,8 +104,17 @@ SerialEngine::SerialEngine() {
     // Initialize zobrist
     init_zobrist();
 
-    // Initialize TT
-    init_transposition_table();
+    // Initialize TT and eval cache
+    clear_eval_caches();
+
+    // Empty pawn hash. Key 0 is a real key (no pawns left), so empty slots get one that won't match.
+    for (auto& entry : pawn_hash_table) {
+        entry = PawnEntry();
+        entry.key = ~0ULL;
+    }
+
+    // King and pawn against king bitbase, built once per process
+    kpk::init();
 
     // Set 1 thread if using Stockfish-based code or no threads
     // ... if needed
@@ -120,30 +155,45 @@ void SerialEngine::init_transposition_table() {
         transposition_table[i].score = 0;
         transposition_table[i].best_move.Invalid();
         transposition_table[i].bound = TTEntry::BOUND_EXACT;
+        transposition_table[i].eval = NO_EVAL;
     }
 }
 
+// Pieces in the Zobrist key order, NO_PIECE for an empty square
+enum Piece {
+    W_PAWN, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING,
+    B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING,
+    NO_PIECE
+};
+
+enum PieceType { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+
+constexpr PieceType type_of(int piece) {
+    return PieceType(piece % 6);
+}
+
+// Board chars (PNBRQK / pnbrqk) to pieces, built once at compile time
+constexpr std::array<uint8_t, 128> make_piece_lookup() {
+    std::array<uint8_t, 128> lookup {};
+    for (auto& piece : lookup) {
+        piece = NO_PIECE;
+    }
+    const char chars[] = "PNBRQKpnbrqk";
+    for (int i = 0; i < 12; i++) {
+        lookup[static_cast<int>(chars[i])] = i;
+    }
+    return lookup;
+}
+
+constexpr std::array<uint8_t, 128> PIECE_FROM_CHAR = make_piece_lookup();
+
 // Map piece chars to indices
 static int piece_to_index(char c) {
-    // White pieces: P=0,N=1,B=2,R=3,Q=4,K=5
-    // Black pieces: p=6,n=7,b=8,r=9,q=10,k=11
-    bool white = isupper(c);
-    char lower = tolower(c);
-    int base = 0;
-    switch (lower) {
-        case 'p': base = 0; break;
-        case 'n': base = 1; break;
-        case 'b': base = 2; break;
-        case 'r': base = 3; break;
-        case 'q': base = 4; break;
-        case 'k': base = 5; break;
-        default: return -1; // not a piece
-    }
-    if (!white) base += 6;
-    return base;
+    return PIECE_FROM_CHAR[static_cast<uint8_t>(c) & 127];
 }
 
 uint64_t SerialEngine::compute_zobrist_key(const thc::ChessRules& cr) {
+    PERF_PHASE(TT);
     uint64_t key = 0ULL;
 
     // Pieces
@@ -151,7 +201,7 @@ uint64_t SerialEngine::compute_zobrist_key(const thc::ChessRules& cr) {
         char c = cr.squares[i];
         if (c != ' ') {
             int idx = piece_to_index(c);
-            if (idx >= 0) {
+            if (idx != NO_PIECE) {
                 key ^= zobrist[idx][i];
             }
         }
@@ -189,20 +239,30 @@ uint64_t SerialEngine::compute_zobrist_key(const thc::ChessRules& cr) {
 
 
 SerialEngine::TTEntry* SerialEngine::probe_tt(uint64_t key) {
+    PERF_PHASE(TT);
     size_t index = (size_t)(key & (TT_SIZE - 1));
     TTEntry &entry = transposition_table[index];
+    counters.tt_probes++;
     if (entry.key == key) {
+        counters.tt_hits++;
         return &entry;
     }
     return nullptr;
 }
 
-void SerialEngine::store_tt(uint64_t key, int depth, int score, TTEntry::BoundType bound, const thc::Move& best_move) {
+void SerialEngine::store_tt(uint64_t key, int depth, Score score, TTEntry::BoundType bound, const thc::Move& best_move,
+                            Score eval) {
+    PERF_PHASE(TT);
     size_t index = (size_t)(key & (TT_SIZE - 1));
     TTEntry &entry = transposition_table[index];
 
     // Replace if deeper
     if (depth > entry.depth) {
+        // Keep the static eval of the same position if this store doesn't bring one
+        if (eval == NO_EVAL && entry.key == key) {
+            eval = entry.eval;
+        }
+        entry.eval = eval;
         entry.key = key;
         entry.depth = depth;
         entry.score = score;
@@ -213,7 +273,7 @@ void SerialEngine::store_tt(uint64_t key, int depth, int score, TTEntry::BoundTy
 
 
 // Piece-square tables for evaluation (a.k.a. heat maps)
-const int pawn_table[64] = {
+constexpr int pawn_table[64] = {
      0,  0,  0,  0,  0,  0,  0,  0,
     50, 50, 50, 50, 50, 50, 50, 50,
     10, 10, 20, 30, 30, 20, 10, 10,
@@ -224,7 +284,7 @@ const int pawn_table[64] = {
      0,  0,  0,  0,  0,  0,  0,  0
 };
 
-const int knight_table[64] = {
+constexpr int knight_table[64] = {
     -50,-40,-30,-30,-30,-30,-40,-50,
     -40,-20,  0,  0,  0,  0,-20,-40,
     -30,  0, 10, 15, 15, 10,  0,-30,
@@ -235,7 +295,7 @@ const int knight_table[64] = {
     -50,-40,-30,-30,-30,-30,-40,-50
 };
 
-const int bishop_table[64] = {
+constexpr int bishop_table[64] = {
     -20,-10,-10,-10,-10,-10,-10,-20,
     -10,  0,  0,  0,  0,  0,  0,-10,
     -10,  0,  5, 10, 10,  5,  0,-10,
@@ -246,7 +306,7 @@ const int bishop_table[64] = {
     -20,-10,-10,-10,-10,-10,-10,-20
 };
 
-const int rook_table[64] = {
+constexpr int rook_table[64] = {
      0,  0,  0,  0,  0,  0,  0,  0,
      5, 10, 10, 10, 10, 10, 10,  5,
     -5,  0,  0,  0,  0,  0,  0, -5,
@@ -257,7 +317,7 @@ const int rook_table[64] = {
      0,  0,  0,  5,  5,  0,  0,  0
 };
 
-const int queen_table[64] = {
+constexpr int queen_table[64] = {
     -20,-10,-10, -5, -5,-10,-10,-20,
     -10,  0,  0,  0,  0,  0,  0,-10,
     -10,  0,  5,  5,  5,  5,  0,-10,
@@ -268,7 +328,7 @@ const int queen_table[64] = {
     -20,-10,-10, -5, -5,-10,-10,-20
 };
 
-const int king_table[64] = {
+constexpr int king_table[64] = {
     -30,-40,-40,-50,-50,-40,-40,-30,
     -30,-40,-40,-50,-50,-40,-40,-30,
     -30,-40,-40,-50,-50,-40,-40,-30,
@@ -279,23 +339,98 @@ const int king_table[64] = {
      20, 30, 10,  0,  0, 10, 30, 20
 };
 
+// The king wants to come to the center once the heavy pieces are gone
+constexpr int king_endgame_table[64] = {
+    -50,-40,-30,-20,-20,-30,-40,-50,
+    -30,-20,-10,  0,  0,-10,-20,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-30,  0,  0,  0,  0,-30,-30,
+    -50,-30,-30,-30,-30,-30,-30,-50
+};
+
+// Material value and game phase contribution by piece type (kings aren't counted, there is always one each)
+constexpr int PIECE_VALUE[6] = {100, 320, 330, 500, 900, 0};
+constexpr int PHASE_WEIGHT[6] = {0, 1, 1, 2, 4, 0};
+
+// Piece-square values by piece and square. The tables above are from White's side, Black's entries are
+// flipped and negated here so every lookup is already from White's point of view.
+constexpr PieceSquareTable make_psq_table(bool endgame) {
+    const int* tables[6] = {
+        pawn_table, knight_table, bishop_table, rook_table, queen_table,
+        endgame ? king_endgame_table : king_table
+    };
+    PieceSquareTable psq {};
+    for (int type = 0; type < 6; type++) {
+        for (int sq = 0; sq < 64; sq++) {
+            psq[type][sq] = tables[type][sq];
+            psq[type + 6][sq] = -tables[type][63 - sq];
+        }
+    }
+    return psq;
+}
+
+constexpr PieceSquareTable PSQ_MG = make_psq_table(false);
+constexpr PieceSquareTable PSQ_EG = make_psq_table(true);
+
+void SerialEngine::update_eval_state(EvalState& state, char piece, int square, int sign) {
+    int p = piece_to_index(piece);
+    PieceType type = type_of(p);
+
+    state.material[p / 6] += sign * PIECE_VALUE[type];
+    state.psq_mg += sign * PSQ_MG[p][square];
+    state.psq_eg += sign * PSQ_EG[p][square];
+    state.phase += sign * PHASE_WEIGHT[type];
+    state.piece_counts[p] += sign;
+    state.pieces[p] ^= square_bb(square);
+    if (type == PAWN) {
+        state.pawn_files[p / 6][square % 8] += sign;
+        state.pawn_key ^= zobrist[p][square];
+    }
+}
+
+// Full rebuild (search root and past MAX_PLY): the mailbox kernels turn the board into piece bitboards and
+// piece-square sums, the rest follows from the bitboards
+void SerialEngine::init_eval_state(const thc::ChessRules& cr, EvalState& state) {
+    state = EvalState();
+
+    uint8_t pieces[64];
+    mailbox_piece_indices(cr.squares, pieces);
+    mailbox_bitboards(pieces, state.pieces);
+    state.psq_mg = mailbox_psq_sum(pieces, PSQ_MG);
+    state.psq_eg = mailbox_psq_sum(pieces, PSQ_EG);
+
+    for (int p = 0; p < 12; p++) {
+        int count = popcount(state.pieces[p]);
+        state.piece_counts[p] = count;
+        state.material[p / 6] += count * PIECE_VALUE[type_of(p)];
+        state.phase += count * PHASE_WEIGHT[type_of(p)];
+    }
+    for (int p : {W_PAWN, B_PAWN}) {
+        for (Bitboard b = state.pieces[p]; b; ) {
+            int sq = pop_lsb(b);
+            state.pawn_files[p / 6][sq % 8]++;
+            state.pawn_key ^= zobrist[p][sq];
+        }
+    }
+}
+
 /* Helper function for move scoring. Capturing larger piece is prioritized first.
  */
 
+// Ordering bonus by captured piece type
+constexpr float CAPTURE_SCORE[6] = {1.0f, 3.0f, 3.0f, 5.0f, 9.0f, 1000.0f}; // King capture shouldn't happen
+
+template <SerialEngine::Color Us>
 float SerialEngine::score_move(const thc::Move& move, thc::ChessRules& cr) {
     float score = 0.0f;
 
     // Check if the move is a capture
     if (move.capture != ' ') {
         // Assign a higher score for capturing higher-value pieces
-        switch (tolower(move.capture)) {
-            case 'p': score += 1.0f; break;
-            case 'n': score += 3.0f; break;
-            case 'b': score += 3.0f; break;
-            case 'r': score += 5.0f; break;
-            case 'q': score += 9.0f; break;
-            case 'k': score += 1000.0f; break; // King capture (shouldn't happen)
-        }
+        score += CAPTURE_SCORE[type_of(piece_to_index(move.capture))];
     }
 
     // Check for promotions
@@ -303,70 +438,51 @@ float SerialEngine::score_move(const thc::Move& move, thc::ChessRules& cr) {
         score += 9.0f; 
     }
 
-    // Positional gain
-    int from_index = static_cast<int>(move.src);
-    int to_index = static_cast<int>(move.dst);
-    char piece = cr.squares[from_index];
-
-    if (isupper(piece)) { // White pieces
-        switch (piece) {
-            case 'P': score += (pawn_table[to_index] - pawn_table[from_index]) / 100.0f; break;
-            case 'N': score += (knight_table[to_index] - knight_table[from_index]) / 100.0f; break;
-            case 'B': score += (bishop_table[to_index] - bishop_table[from_index]) / 100.0f; break;
-            case 'R': score += (rook_table[to_index] - rook_table[from_index]) / 100.0f; break;
-            case 'Q': score += (queen_table[to_index] - queen_table[from_index]) / 100.0f; break;
-            case 'K': score += (king_table[to_index] - king_table[from_index]) / 100.0f; break;
-        }
-    } else { // Black pieces
-        int flipped_from_index = 63 - from_index;
-        int flipped_to_index = 63 - to_index;
-
-        switch (piece) {
-            case 'p': score += (pawn_table[flipped_to_index] - pawn_table[flipped_from_index]) / 100.0f; break;
-            case 'n': score += (knight_table[flipped_to_index] - knight_table[flipped_from_index]) / 100.0f; break;
-            case 'b': score += (bishop_table[flipped_to_index] - bishop_table[flipped_from_index]) / 100.0f; break;
-            case 'r': score += (rook_table[flipped_to_index] - rook_table[flipped_from_index]) / 100.0f; break;
-            case 'q': score += (queen_table[flipped_to_index] - queen_table[flipped_from_index]) / 100.0f; break;
-            case 'k': score += (king_table[flipped_to_index] - king_table[flipped_from_index]) / 100.0f; break;
-        }
-    }
+    // Positional gain, the tables are from White's point of view so Black's gain is the negated difference
+    int piece = piece_to_index(cr.squares[move.src]);
+    int gain = PSQ_MG[piece][move.dst] - PSQ_MG[piece][move.src];
+    score += (Us == WHITE ? gain : -gain) / 100.0f;
 
     return score;
 }
 
-// Add a mobility bonus for the pieces (not sure if this helps).
-int SerialEngine::evaluate_mobility(thc::ChessRules& cr, bool is_white, const std::vector<int>& piece_indices) {
+// Out-of-line copies for bench/engine-bench.cpp, the search inlines its own
+template float SerialEngine::score_move<SerialEngine::WHITE>(const thc::Move& move, thc::ChessRules& cr);
+template float SerialEngine::score_move<SerialEngine::BLACK>(const thc::Move& move, thc::ChessRules& cr);
+
+// Add a mobility bonus for the pieces (not sure if this helps). Counts the squares each piece attacks that are
+// neither occupied by its own side nor covered by an enemy pawn, straight from the piece bitboards.
+template <SerialEngine::Color Us>
+int SerialEngine::evaluate_mobility(const EvalState& state) {
+    constexpr Color Them = Us == WHITE ? BLACK : WHITE;
+    const Bitboard* own = state.pieces + 6 * Us;
+    const Bitboard* enemy = state.pieces + 6 * Them;
+
+    Bitboard own_pieces = own[0] | own[1] | own[2] | own[3] | own[4] | own[5];
+    Bitboard enemy_pieces = enemy[0] | enemy[1] | enemy[2] | enemy[3] | enemy[4] | enemy[5];
+    Bitboard occupied = own_pieces | enemy_pieces;
+    Bitboard safe = ~own_pieces & ~pawn_attacks(enemy[0], Them == WHITE);
+
     int mobility_score = 0;
-    thc::ChessRules cr_copy = cr;
-    std::vector<thc::Move> moves;
-    cr_copy.GenLegalMoveList(moves);
-
-    for (const auto& move : moves) {
-        char piece = cr_copy.squares[move.src];
-        if ((is_white && isupper(piece)) || (!is_white && islower(piece))) {
-            char lower_piece = tolower(piece);
-            switch (lower_piece) {
-                case 'n': mobility_score += 4; break;
-                case 'b': mobility_score += 4; break;
-                case 'r': mobility_score += 2; break;
-                case 'q': mobility_score += 1; break;
-                default: break;
-            }
-        }
+    for (Bitboard b = own[1]; b; ) {
+        mobility_score += 4 * popcount(knight_attacks(pop_lsb(b)) & safe);
+    }
+    for (Bitboard b = own[2]; b; ) {
+        mobility_score += 4 * popcount(bishop_attacks(pop_lsb(b), occupied) & safe);
+    }
+    for (Bitboard b = own[3]; b; ) {
+        mobility_score += 2 * popcount(rook_attacks(pop_lsb(b), occupied) & safe);
+    }
+    for (Bitboard b = own[4]; b; ) {
+        mobility_score += 1 * popcount(queen_attacks(pop_lsb(b), occupied) & safe);
     }
 
     return mobility_score;
 }
 
-int SerialEngine::evaluate_pawn_structure(const std::vector<int>& pawn_files, bool is_white) {
+int SerialEngine::evaluate_pawn_structure(const int file_counts[8], bool is_white) {
     int score = 0;
 
-    // Count pawns on each file
-    int file_counts[8] = {0};
-    for (int file : pawn_files) {
-        file_counts[file]++;
-    }
-
     // Evaluate pawn structure
     int pawn_islands = 0;
     bool in_island = false;
@@ -404,7 +520,50 @@ int SerialEngine::evaluate_pawn_structure(const std::vector<int>& pawn_files, bo
     return score;
 }
 
-int SerialEngine::evaluate_king_safety(thc::ChessRules& cr, int king_index, bool is_white, bool endgame) {
+const SerialEngine::PawnEntry& SerialEngine::probe_pawn_hash(const EvalState& state) {
+    counters.pawn_hash_probes++;
+    PawnEntry& entry = pawn_hash_table[state.pawn_key & (PAWN_HASH_SIZE - 1)];
+    if (entry.key == state.pawn_key) {
+        counters.pawn_hash_hits++;
+        return entry;
+    }
+
+    entry.key = state.pawn_key;
+    entry.score = evaluate_pawn_structure(state.pawn_files[WHITE], true)
+                - evaluate_pawn_structure(state.pawn_files[BLACK], false);
+
+    Bitboard white_pawns = state.pieces[W_PAWN];
+    Bitboard black_pawns = state.pieces[B_PAWN];
+
+    // A pawn is passed if no enemy pawn stands in front of it on its own or an adjacent file
+    entry.passed[WHITE] = 0;
+    entry.passed[BLACK] = 0;
+    for (Bitboard b = white_pawns; b; ) {
+        int sq = pop_lsb(b);
+        if (!(black_pawns & file_span_bb(sq % 8) & forward_rows_bb(sq, true))) {
+            entry.passed[WHITE] |= square_bb(sq);
+        }
+    }
+    for (Bitboard b = black_pawns; b; ) {
+        int sq = pop_lsb(b);
+        if (!(white_pawns & file_span_bb(sq % 8) & forward_rows_bb(sq, false))) {
+            entry.passed[BLACK] |= square_bb(sq);
+        }
+    }
+
+    entry.semi_open_files[WHITE] = 0;
+    entry.semi_open_files[BLACK] = 0;
+    for (int file = 0; file < 8; file++) {
+        if (state.pawn_files[WHITE][file] == 0) entry.semi_open_files[WHITE] |= 1 << file;
+        if (state.pawn_files[BLACK][file] == 0) entry.semi_open_files[BLACK] |= 1 << file;
+    }
+    entry.open_files = entry.semi_open_files[WHITE] & entry.semi_open_files[BLACK];
+
+    return entry;
+}
+
+template <SerialEngine::Color Us>
+int SerialEngine::evaluate_king_safety(thc::ChessRules& cr, int king_index, bool endgame, const PawnEntry& pawns) {
     int safety_score = 0;
 
     if (king_index == -1) return safety_score; // King not found
@@ -422,7 +581,8 @@ int SerialEngine::evaluate_king_safety(thc::ChessRules& cr, int king_index, bool
 
     // Evaluate pawn shield
     int pawn_shield_bonus = 0;
-    int direction = is_white ? -1 : 1; // Direction towards opponent
+    constexpr int direction = Us == WHITE ? -1 : 1; // Direction towards opponent
+    constexpr char own_pawn = Us == WHITE ? 'P' : 'p';
 
     for (int df = -1; df <= 1; ++df) {
         int shield_rank = rank + direction;
@@ -430,7 +590,7 @@ int SerialEngine::evaluate_king_safety(thc::ChessRules& cr, int king_index, bool
         if (shield_rank >= 0 && shield_rank <= 7 && shield_file >= 0 && shield_file <= 7) {
             int shield_index = shield_rank * 8 + shield_file;
             char shield_piece = cr.squares[shield_index];
-            if ((is_white && shield_piece == 'P') || (!is_white && shield_piece == 'p')) {
+            if (shield_piece == own_pawn) {
                 pawn_shield_bonus += 10;
             }
         }
@@ -442,11 +602,15 @@ int SerialEngine::evaluate_king_safety(thc::ChessRules& cr, int king_index, bool
     if (pawn_shield_bonus == 0) {
         safety_score -= 20; // King is exposed
     }
+    if (pawns.semi_open_files[Us] & (1 << file)) {
+        safety_score -= 10; // No own pawn in front of the king on its file
+    }
 
     return safety_score;
 }
 
-int SerialEngine::evaluate_king_activity(int own_king_index, int opponent_king_index, bool is_white) {
+template <SerialEngine::Color Us>
+int SerialEngine::evaluate_king_activity(int own_king_index, int opponent_king_index) {
     int activity_score = 0;
 
     int rank = own_king_index / 8;
@@ -462,7 +626,7 @@ int SerialEngine::evaluate_king_activity(int own_king_index, int opponent_king_i
     int opponent_rank = opponent_king_index / 8;
     int opponent_file = opponent_king_index % 8;
     int king_distance = std::abs(rank - opponent_rank) + std::abs(file - opponent_file);
-    if (is_white) {
+    if (Us == WHITE) {
         activity_score -= king_distance * 2; // Encourage approaching opponent's king
     } 
     else {
@@ -484,180 +648,362 @@ bool SerialEngine::is_endgame(int white_material, int black_material) {
     return total_material <= ENDGAME_MATERIAL_THRESHOLD; // Define a threshold, e.g., 2400 (two rooks)
 }
 
-SerialEngine::Score SerialEngine::static_eval(thc::ChessRules& cr) {
-    Score total_score = 0.0f;
+bool SerialEngine::load_network(const std::string& path) {
+    if (!network.load(path)) {
+        return false;
+    }
+    network.reset_cache(refresh_cache);
+    clear_eval_caches();
+    eval_mode = EvalMode::NNUE;
+    return true;
+}
 
-    // Material counts
-    int white_material = 0;
-    int black_material = 0;
+void SerialEngine::set_eval_mode(EvalMode mode) {
+    if (mode == EvalMode::NNUE && !network.is_loaded()) {
+        std::cerr << "NNUE: no network loaded, staying with classical evaluation" << std::endl;
+        return;
+    }
+    if (mode != eval_mode) {
+        clear_eval_caches();
+    }
+    eval_mode = mode;
+}
 
-    // Piece counts for bishop pair evaluation
-    int white_bishops = 0;
-    int black_bishops = 0;
+// Cached evals belong to one evaluation, drop them when it changes
+void SerialEngine::clear_eval_caches() {
+    init_transposition_table();
+    for (auto& slot : eval_cache) {
+        slot.key = 0;
+        slot.eval = NO_EVAL;
+    }
+}
 
-    // King positions
-    int white_king_index = -1;
-    int black_king_index = -1;
+int SerialEngine::set_syzygy_path(const std::string& path) {
+    if (!syzygy::SEARCH_ENABLED) {
+        return 0;
+    }
+    int largest = syzygy::init(path);
+    clear_eval_caches();
+    return largest;
+}
 
-    // Variables for pawn structure
-    std::vector<int> white_pawn_files;
-    std::vector<int> black_pawn_files;
+bool SerialEngine::set_book(const std::string& path, int max_ply) {
+    book_max_ply = max_ply;
+    return opening_book.open(path);
+}
 
-    // Piece positions for mobility evaluation
-    std::vector<int> white_piece_indices;
-    std::vector<int> black_piece_indices;
+int SerialEngine::set_egtb_path(const std::string& path) {
+    int largest = egtb::init(path);
+    clear_eval_caches();
+    return largest;
+}
 
-    // Evaluate material and positional bonuses
-    for (int i = 0; i < 64; i++) {
-        char piece = cr.squares[i];
-        if (piece == ' ')
-            continue;
+SerialEngine::Score SerialEngine::evaluate(thc::ChessRules& cr) {
+    ply = 0;
+    init_eval_state(cr, eval_stack[0]);
+    if (eval_mode == EvalMode::NNUE) {
+        network.refresh(cr, accumulator_stack[0], refresh_cache);
+    }
+    bool exact;
+    return static_eval(cr, -INF_SCORE, INF_SCORE, exact);
+}
 
-        int index = i;
-        int flipped_index = 63 - i; // Flips the board for Black
-        int piece_value = 0;
-        float positional_bonus = 0.0f;
-
-        bool is_white = isupper(piece);
-        char lower_piece = tolower(piece);
-
-        switch (lower_piece) {
-            case 'p':
-                piece_value = 100;
-                positional_bonus = pawn_table[is_white ? index : flipped_index] / 1.0f;
-                if (is_white) {
-                    white_material += piece_value;
-                    white_pawn_files.push_back(index % 8);
-                } else {
-                    black_material += piece_value;
-                    black_pawn_files.push_back(index % 8);
-                }
-                break;
-            case 'n':
-                piece_value = 320;
-                positional_bonus = knight_table[is_white ? index : flipped_index] / 1.0f;
-                if (is_white) {
-                    white_material += piece_value;
-                    white_piece_indices.push_back(index);
-                } else {
-                    black_material += piece_value;
-                    black_piece_indices.push_back(index);
-                }
-                break;
-            case 'b':
-                piece_value = 330;
-                positional_bonus = bishop_table[is_white ? index : flipped_index] / 1.0f;
-                if (is_white) {
-                    white_material += piece_value;
-                    white_bishops++;
-                    white_piece_indices.push_back(index);
-                } else {
-                    black_material += piece_value;
-                    black_bishops++;
-                    black_piece_indices.push_back(index);
-                }
-                break;
-            case 'r':
-                piece_value = 500;
-                positional_bonus = rook_table[is_white ? index : flipped_index] / 1.0f;
-                if (is_white) {
-                    white_material += piece_value;
-                    white_piece_indices.push_back(index);
-                } else {
-                    black_material += piece_value;
-                    black_piece_indices.push_back(index);
-                }
-                break;
-            case 'q':
-                piece_value = 900;
-                positional_bonus = queen_table[is_white ? index : flipped_index] / 1.0f;
-                if (is_white) {
-                    white_material += piece_value;
-                    white_piece_indices.push_back(index);
-                } else {
-                    black_material += piece_value;
-                    black_piece_indices.push_back(index);
-                }
-                break;
-            case 'k':
-                piece_value = 20000; // High value for the King
-                positional_bonus = king_table[is_white ? index : flipped_index] / 1.0f;
-                if (is_white) {
-                    white_king_index = index;
-                } else {
-                    black_king_index = index;
-                }
-                break;
-            default:
-                break;
-        }
+void SerialEngine::set_lazy_eval_margins(Score middlegame, Score endgame) {
+    lazy_margin_mg = middlegame;
+    lazy_margin_eg = endgame;
+}
 
-        Score square_score = piece_value + positional_bonus;
-        if (is_white) {
-            total_score += square_score;
-        } else {
-            total_score -= square_score;
+SerialEngine::Score SerialEngine::cached_static_eval(thc::ChessRules& cr, uint64_t key, TTEntry* entry,
+                                                     Score alpha, Score beta, bool& exact) {
+    exact = true;
+    counters.eval_probes++;
+    if (entry && entry->eval != NO_EVAL) {
+        counters.eval_tt_hits++;
+        return entry->eval;
+    }
+
+    EvalCacheEntry& slot = eval_cache[key & (EVAL_CACHE_SIZE - 1)];
+    if (slot.key == key && slot.eval != NO_EVAL) {
+        counters.eval_cache_hits++;
+        if (entry) entry->eval = slot.eval;
+        return slot.eval;
+    }
+
+    Score eval;
+    if (counters.evaluations++ % EVAL_TIMING_INTERVAL == 0) {
+        auto eval_start = std::chrono::steady_clock::now();
+        eval = static_eval(cr, alpha, beta, exact);
+        std::chrono::duration<double> eval_time = std::chrono::steady_clock::now() - eval_start;
+        counters.timed_evaluations++;
+        counters.timed_eval_seconds += eval_time.count();
+    } else {
+        eval = static_eval(cr, alpha, beta, exact);
+    }
+
+    // A lazy eval only holds for this window
+    if (!exact) {
+        return eval;
+    }
+
+    slot.key = key;
+    slot.eval = eval;
+    if (entry) entry->eval = eval;
+    return eval;
+}
+
+void SerialEngine::push_move(thc::ChessRules& cr, thc::Move& move) {
+    PERF_PHASE(MAKE_UNMAKE);
+    if (ply + 1 >= MAX_PLY) {
+        cr.PushMove(move);
+        ply++;
+        return;
+    }
+
+    int touched[4];
+    char before[4];
+    int count = nnue::touched_squares(move, touched);
+    for (int i = 0; i < count; i++) {
+        before[i] = cr.squares[touched[i]];
+    }
+
+    cr.PushMove(move);
+    ply++;
+
+    const nnue::DirtyPieces& dirty = dirty_stack[ply] = nnue::diff_squares(touched, before, count, cr);
+
+    // Material and piece-square sums follow the move right away
+    EvalState& state = eval_stack[ply];
+    state = eval_stack[ply - 1];
+    for (int i = 0; i < dirty.removed_count; i++) {
+        update_eval_state(state, dirty.removed_piece[i], dirty.removed_square[i], -1);
+    }
+    for (int i = 0; i < dirty.added_count; i++) {
+        update_eval_state(state, dirty.added_piece[i], dirty.added_square[i], 1);
+    }
+
+    // Accumulators wait until nnue_eval needs them
+    accumulator_stack[ply].computed[nnue::WHITE] = false;
+    accumulator_stack[ply].computed[nnue::BLACK] = false;
+}
+
+void SerialEngine::pop_move(thc::ChessRules& cr, thc::Move& move) {
+    PERF_PHASE(MAKE_UNMAKE);
+    cr.PopMove(move);
+    ply--;
+}
+
+SerialEngine::Score SerialEngine::static_eval(thc::ChessRules& cr, Score alpha, Score beta, bool& exact) {
+    PERF_PHASE(EVAL);
+    exact = true;
+
+    // King and pawn against king is looked up instead of evaluated
+    if (ply < MAX_PLY) {
+        const EvalState& state = eval_stack[ply];
+        if (state.material[WHITE] + state.material[BLACK] == PIECE_VALUE[PAWN]
+            && state.piece_counts[W_PAWN] + state.piece_counts[B_PAWN] == 1) {
+            return kpk_eval(cr, state);
         }
     }
 
-    // Bishop pair bonus
-    if (white_bishops >= 2) total_score += 50;
-    if (black_bishops >= 2) total_score -= 50;
+    if (eval_mode == EvalMode::NNUE) {
+        return nnue_eval(cr);
+    }
+    return classical_eval(cr, alpha, beta, exact);
+}
+
+// Won KPK positions score below a fresh queen so that promoting still looks like progress, plus a bonus for
+// how far the pawn has come. Everything else is a dead draw.
+constexpr int KPK_WIN_SCORE = 700;
+
+SerialEngine::Score SerialEngine::kpk_eval(thc::ChessRules& cr, const EvalState& state) {
+    bool strong_is_white = state.piece_counts[W_PAWN] == 1;
+    int pawn = lsb(state.pieces[strong_is_white ? W_PAWN : B_PAWN]);
+    int strong_king = strong_is_white ? cr.wking_square : cr.bking_square;
+    int weak_king = strong_is_white ? cr.bking_square : cr.wking_square;
+
+    if (!kpk::probe(strong_king, weak_king, pawn, strong_is_white, cr.WhiteToPlay())) {
+        return 0.0f;
+    }
+    int advance = strong_is_white ? 6 - pawn / 8 : pawn / 8 - 1;
+    Score score = KPK_WIN_SCORE + 20 * advance;
+    return strong_is_white ? score : -score;
+}
+
+SerialEngine::Score SerialEngine::nnue_eval(thc::ChessRules& cr) {
+    // Past the end of the stack there is no accumulator to reuse, compute one from scratch
+    if (ply >= MAX_PLY) {
+        nnue::Accumulator scratch;
+        network.refresh(cr, scratch);
+        int score = network.evaluate(scratch, cr.WhiteToPlay());
+        return cr.WhiteToPlay() ? score : -score;
+    }
+
+    EVAL_TRACE_BEGIN(NNUE);
+    network.update_lazy(accumulator_stack.data(), dirty_stack.data(), ply, cr, refresh_cache);
+
+    // The network scores for the side to move, the search wants White's point of view
+    int score = network.evaluate(accumulator_stack[ply], cr.WhiteToPlay());
+    score = cr.WhiteToPlay() ? score : -score;
+    EVAL_TRACE_END(NNUE, score);
+    return score;
+}
+
+SerialEngine::Score SerialEngine::classical_eval(thc::ChessRules& cr, Score alpha, Score beta, bool& exact) {
+    EVAL_TRACE_BEGIN(TOTAL);
+
+    // Past the end of the stack the incremental state isn't tracked, build it for this position
+    EvalState scratch;
+    if (ply >= MAX_PLY) {
+        init_eval_state(cr, scratch);
+    }
+    const EvalState& state = ply < MAX_PLY ? eval_stack[ply] : scratch;
+
+    // Material, with a bishop pair bonus
+    EVAL_TRACE_BEGIN(MATERIAL);
+    Score material = state.material[WHITE] - state.material[BLACK];
+    if (state.piece_counts[W_BISHOP] >= 2) material += 50;
+    if (state.piece_counts[B_BISHOP] >= 2) material -= 50;
+    EVAL_TRACE_END(MATERIAL, material);
+
+    // Piece-square tables, blending the middlegame and endgame tables by game phase
+    EVAL_TRACE_BEGIN(PSQ);
+    int phase = std::min(state.phase, MAX_PHASE);
+    Score psq = (state.psq_mg * phase + state.psq_eg * (MAX_PHASE - phase)) / static_cast<Score>(MAX_PHASE);
+    EVAL_TRACE_END(PSQ, psq);
+
+    Score total_score = material + psq;
+
+    // Lazy exit: when the remaining terms can't bring the score back into the window, the bound is decided.
+    // Return the bound itself (the most the skipped terms could add or take away), it still fails low or
+    // high and never claims more than the cheap terms prove.
+    counters.lazy_eval_calls++;
+    Score lazy_margin = (lazy_margin_mg * phase + lazy_margin_eg * (MAX_PHASE - phase)) / MAX_PHASE;
+    if (total_score + lazy_margin <= alpha || total_score - lazy_margin >= beta) {
+        counters.lazy_eval_skips++;
+        exact = false;
+        Score bound = total_score + lazy_margin <= alpha ? total_score + lazy_margin : total_score - lazy_margin;
+        EVAL_TRACE_LAZY_EXIT();
+        EVAL_TRACE_END(TOTAL, bound);
+        return bound;
+    }
+
+    int white_king_index = cr.wking_square;
+    int black_king_index = cr.bking_square;
 
     // Mobility evaluation
-    total_score += evaluate_mobility(cr, true, white_piece_indices);
-    total_score -= evaluate_mobility(cr, false, black_piece_indices);
+    EVAL_TRACE_BEGIN(MOBILITY);
+    int mobility = evaluate_mobility<WHITE>(state) - evaluate_mobility<BLACK>(state);
+    EVAL_TRACE_END(MOBILITY, mobility);
+    total_score += mobility;
 
     // Pawn structure evaluation
-    total_score += evaluate_pawn_structure(white_pawn_files, true);
-    total_score -= evaluate_pawn_structure(black_pawn_files, false);
+    EVAL_TRACE_BEGIN(PAWNS);
+    const PawnEntry& pawns = probe_pawn_hash(state);
+    EVAL_TRACE_END(PAWNS, pawns.score);
+    total_score += pawns.score;
 
     // King safety evaluation
+    EVAL_TRACE_BEGIN(KING_SAFETY);
+    bool endgame = is_endgame(state.material[WHITE], state.material[BLACK]);
+    int king_safety = evaluate_king_safety<WHITE>(cr, white_king_index, endgame, pawns)
+                    - evaluate_king_safety<BLACK>(cr, black_king_index, endgame, pawns);
+    EVAL_TRACE_END(KING_SAFETY, king_safety);
+    total_score += king_safety;
 
-    bool endgame = is_endgame(white_material, black_material);
-
-    total_score += evaluate_king_safety(cr, white_king_index, true, endgame);
-    total_score -= evaluate_king_safety(cr, black_king_index, false, endgame);
-
-    // After calculating total material
-    
     // Evaluate king activity in endgame
     if (endgame) {
-        total_score += evaluate_king_activity(white_king_index, black_king_index, true);
-        total_score -= evaluate_king_activity(black_king_index, white_king_index, false);
+        EVAL_TRACE_BEGIN(KING_ACTIVITY);
+        int king_activity = evaluate_king_activity<WHITE>(white_king_index, black_king_index)
+                          - evaluate_king_activity<BLACK>(black_king_index, white_king_index);
+        EVAL_TRACE_END(KING_ACTIVITY, king_activity);
+        total_score += king_activity;
     }
 
-
+    EVAL_TRACE_END(TOTAL, total_score);
     return total_score;
 }
 
-int debug_node_count = 0;
-
 thc::Move SerialEngine::solve(thc::ChessRules& cr, bool is_white_player) {
     this->time_limit_reached = false;
     this->start_time = std::chrono::steady_clock::now();
+    last_stats = SearchStats();
+
+    // Book moves are played instantly
+    int game_ply = (cr.full_move_count - 1) * 2 + (cr.white ? 0 : 1);
+    SEARCH_TRACE_SCOPE("search", "ply", game_ply);
+    thc::Move book_move;
+    if (opening_book.is_open() && game_ply < book_max_ply && opening_book.pick(cr, book_rng, book_move)) {
+        SEARCH_TRACE_INSTANT("book move");
+        if (log_output) {
+            *log_output << "Book move: " << book_move.NaturalOut(&cr) << std::endl;
+        }
+        return book_move;
+    }
+
+    // The root eval state and accumulator are built from scratch, everything below them is incremental
+    ply = 0;
+    init_eval_state(cr, eval_stack[0]);
+    if (eval_mode == EvalMode::NNUE) {
+        network.refresh(cr, accumulator_stack[0], refresh_cache);
+    }
+
+    // In tablebase range the root only keeps the moves that preserve the best DTZ (or DTM) result
+    tb_root_moves.clear();
+    if (syzygy::max_pieces() > 0 || egtb::max_pieces() > 0) {
+        SEARCH_TRACE_SCOPE("tablebase root filter");
+        int piece_count = 0;
+        for (int count : eval_stack[0].piece_counts) {
+            piece_count += count;
+        }
+        std::vector<thc::Move> moves;
+        cr.GenLegalMoveList(moves);
+        if (piece_count <= syzygy::max_pieces() && syzygy::filter_root_moves(cr, moves)) {
+            tb_root_moves = moves;
+        } else if (piece_count <= egtb::max_pieces() && egtb::filter_root_moves(cr, moves)) {
+            tb_root_moves = moves;
+        }
+    }
 
     thc::Move best_move_so_far;
     bool move_found = false;
-
-    for (int current_depth = 1; current_depth <= MAX_DEPTH; ++current_depth) {
-        debug_node_count = 0;
+    EVAL_TRACE_RESET();
+    PERF_START();
+
+    // Each iteration's counters (and tablebase probes) are added to the search totals as it ends
+    auto end_iteration = [&] {
+        last_stats.add(counters);
+        last_stats.tb_probes += syzygy::stats().probes;
+        last_stats.tb_hits += syzygy::stats().hits;
+        last_stats.egtb_probes += egtb::stats().probes;
+        last_stats.egtb_hits += egtb::stats().hits;
+    };
+
+    for (int current_depth = 1; current_depth <= max_depth; ++current_depth) {
+        counters = SearchCounters();
+        syzygy::stats() = syzygy::Stats();
+        egtb::stats() = egtb::Stats();
         if (time_limit_reached) {
             break; 
         }
 
         thc::Move current_best_move;
-        Score current_score = solve_serial_engine(
-            cr,
-            is_white_player,
-            current_best_move,
-            0,
-            current_depth, 
-            -INF_SCORE,
-            INF_SCORE
-        );
+        Score current_score;
+        {
+            SEARCH_TRACE_SCOPE("iteration", "depth", current_depth);
+            current_score = solve_serial_engine(
+                cr,
+                is_white_player,
+                current_best_move,
+                0,
+                current_depth, 
+                -INF_SCORE,
+                INF_SCORE
+            );
+        }
+        end_iteration();
 
         if (time_limit_reached) {
+            SEARCH_TRACE_INSTANT("time stop", "depth", current_depth);
             break; 
         }
 
@@ -665,16 +1011,53 @@ thc::Move SerialEngine::solve(thc::ChessRules& cr, bool is_white_player) {
         move_found = true;
 
         // Debug output (record this data as metric for engine performance)
+        uint64_t eval_probes = counters.eval_probes;
+        uint64_t eval_hits = counters.eval_tt_hits + counters.eval_cache_hits;
+        double average_eval_seconds = counters.timed_evaluations
+            ? counters.timed_eval_seconds / counters.timed_evaluations : 0.0;
         auto current_time = std::chrono::steady_clock::now();
         std::chrono::duration<double> elapsed_seconds = current_time - start_time;
-        std::cout << "Depth: " <<  current_depth 
+        last_stats.iterations.push_back({current_depth, current_score, elapsed_seconds.count(), counters.nodes});
+        if (!log_output) {
+            continue;
+        }
+        std::ostream& out = *log_output;
+        out << "Depth: " <<  current_depth 
         << ", Score: " << (current_score / 100.0f) 
         << ", Time: " << elapsed_seconds.count() << "s" 
-        << ", Nodes Evaluated = " << debug_node_count 
-        << ", knps: " << (debug_node_count/1000.0) / elapsed_seconds.count() 
-        << std::endl;
+        << ", Nodes: " << counters.nodes << " (leaves " << counters.leaves << ")"
+        << ", knps: " << (counters.nodes/1000.0) / elapsed_seconds.count() 
+        << ", TT hits: " << (counters.tt_probes ? 100.0 * counters.tt_hits / counters.tt_probes : 0.0) << "%"
+        << ", First move cutoffs: "
+        << (counters.beta_cutoffs ? 100.0 * counters.cutoffs_by_move[0] / counters.beta_cutoffs : 0.0) << "%"
+        << ", Pawn hash hits: "
+        << (counters.pawn_hash_probes ? 100.0 * counters.pawn_hash_hits / counters.pawn_hash_probes : 0.0) << "%"
+        << ", Eval cache hits: " << (eval_probes ? 100.0 * eval_hits / eval_probes : 0.0) << "%"
+        << " (TT " << (eval_probes ? 100.0 * counters.eval_tt_hits / eval_probes : 0.0) << "%)"
+        << ", Eval time saved: ~" << eval_hits * average_eval_seconds * 1000.0 << "ms"
+        << ", Lazy eval skips: "
+        << (counters.lazy_eval_calls ? 100.0 * counters.lazy_eval_skips / counters.lazy_eval_calls : 0.0) << "%";
+        if (syzygy::max_pieces() > 0) {
+            const syzygy::Stats& tb = syzygy::stats();
+            out << ", TB probes: " << tb.probes
+            << " (hits " << (tb.probes ? 100.0 * tb.hits / tb.probes : 0.0) << "%)";
+        }
+        if (egtb::max_pieces() > 0) {
+            const egtb::Stats& tb = egtb::stats();
+            out << ", EGTB probes: " << tb.probes
+            << " (hits " << (tb.probes ? 100.0 * tb.hits / tb.probes : 0.0) << "%)";
+        }
+        out << std::endl;
     }
 
+    std::chrono::duration<double> search_seconds = std::chrono::steady_clock::now() - start_time;
+    last_stats.seconds = search_seconds.count();
+    if (stats_output) {
+        *stats_output << last_stats.to_json() << std::endl;
+    }
+    EVAL_TRACE_PRINT(std::cout);
+    PERF_PRINT(std::cout, last_stats.counters.nodes);
+
     if (move_found) {
         return best_move_so_far;
     } else {
@@ -691,11 +1074,15 @@ thc::Move SerialEngine::solve(thc::ChessRules& cr, bool is_white_player) {
 }
 
 SerialEngine::Score SerialEngine::quiesce(thc::ChessRules &cr, Score alpha, Score beta) {
-    // Increment node count for quiescence nodes if you like
-    debug_node_count++;
+    PERF_PHASE(QUIESCE);
+    counters.nodes++;
+    counters.qnodes++;
 
-    // Evaluate the position statically
-    Score stand_pat = static_eval(cr);
+    // Evaluate the position statically. The lazy eval bounds a White point of view window and this one is
+    // the side to move's, so the eval is always exact here.
+    uint64_t key = compute_zobrist_key(cr);
+    bool exact;
+    Score stand_pat = cached_static_eval(cr, key, probe_tt(key), -INF_SCORE, INF_SCORE, exact);
 
     // Check for cutoff
     if (stand_pat >= beta) {
@@ -720,8 +1107,9 @@ SerialEngine::Score SerialEngine::quiesce(thc::ChessRules &cr, Score alpha, Scor
 
     // Order capture moves by value of captured piece (MVV-LVA) or use score_move()
     std::vector<std::pair<float, thc::Move>> scored_moves;
+    bool white_to_move = cr.WhiteToPlay();
     for (auto &m : capture_moves) {
-        float score = score_move(m, cr);
+        float score = white_to_move ? score_move<WHITE>(m, cr) : score_move<BLACK>(m, cr);
         scored_moves.emplace_back(score, m);
     }
 
@@ -734,12 +1122,12 @@ SerialEngine::Score SerialEngine::quiesce(thc::ChessRules &cr, Score alpha, Scor
         thc::Move &move = entry.second;
 
         // Make the capture move
-        cr.PushMove(move);
+        push_move(cr, move);
 
         Score val = -quiesce(cr, -beta, -alpha);
 
         // Undo move
-        cr.PopMove(move);
+        pop_move(cr, move);
 
         if (time_limit_reached) {
             return 0.0f;
@@ -765,6 +1153,8 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
     Score alpha_score,
     Score beta_score
 ) {
+    PERF_PHASE(SEARCH);
+
     // Check if time limit has been reached
     if (time_limit_reached) {
         return 0.0f;
@@ -780,6 +1170,8 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
         }
     }
 
+    counters.nodes++;
+
     // Compute key
     uint64_t key = compute_zobrist_key(cr);
 
@@ -794,12 +1186,14 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
         switch (entry->bound) {
             case TTEntry::BOUND_EXACT:
                 // Exact bound: just return the stored score
+                counters.tt_cutoffs++;
                 return entry->score;
 
             case TTEntry::BOUND_LOWER:
                 // Lower bound means score >= entry->score
                 // If entry->score >= beta_score, fail-high, return immediately
                 if (entry->score >= beta_score) {
+                    counters.tt_cutoffs++;
                     return entry->score;
                 }
                 // Otherwise, update alpha if we can improve it
@@ -810,6 +1204,7 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
                 // Upper bound means score <= entry->score
                 // If entry->score <= alpha_score, fail-low, return immediately
                 if (entry->score <= alpha_score) {
+                    counters.tt_cutoffs++;
                     return entry->score;
                 }
                 // Otherwise, update beta if we can lower it
@@ -823,12 +1218,15 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
             // If it was a lower bound failure, we failed high at beta, so return beta_score
             // If it was an upper bound failure, we failed low at alpha, so return alpha_score
             // For exact bound, we would have returned already.
+            counters.tt_cutoffs++;
             return entry->score;
             // return (entry->bound == TTEntry::BOUND_LOWER) ? beta_score : alpha_score;
         }
     }
 
 
+    // Repetition, mate and stalemate checks generate moves too
+    PERF_SWITCH(MOVEGEN);
     thc::DRAWTYPE draw_reason;
     if (cr.IsDraw(false, draw_reason)) {
         return 0.0f;
@@ -838,25 +1236,76 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
     thc::TERMINAL terminal;
     if (cr.Evaluate(terminal)) {
         if (terminal == thc::TERMINAL_WCHECKMATE) {
-            debug_node_count++;
+            counters.leaves++;
             return -INF_SCORE + depth; // White is checkmated
         } else if (terminal == thc::TERMINAL_BCHECKMATE) {
-            debug_node_count++;
+            counters.leaves++;
             return INF_SCORE - depth; // Black is checkmated
         } else if (terminal == thc::TERMINAL_WSTALEMATE || terminal == thc::TERMINAL_BSTALEMATE) {
-            debug_node_count++;
+            counters.leaves++;
             return 0.0f; // Stalemate is a draw
         }
     }
+    PERF_SWITCH(SEARCH);
+
+    // Tablebases: right after a capture or pawn move into tablebase range, the table decides the subtree.
+    // Syzygy first, then the distance to mate tables (which also rank wins by their length).
+    if (depth > 0 && cr.half_move_clock == 0 && ply < MAX_PLY && (syzygy::max_pieces() > 0 || egtb::max_pieces() > 0)) {
+        int piece_count = 0;
+        for (int count : eval_stack[ply].piece_counts) {
+            piece_count += count;
+        }
+        syzygy::WDL wdl;
+        egtb::WDL dtm_wdl;
+        int mate_plies;
+        bool found = false;
+        Score tb_score = 0.0f;
+        if (piece_count <= syzygy::max_pieces() && syzygy::probe_wdl(cr, wdl)) {
+            // Wins are scored below mates and prefer fewer plies, cursed wins and blessed losses are draws
+            tb_score = wdl == syzygy::WIN ? TB_WIN_SCORE - depth
+                     : wdl == syzygy::LOSS ? -TB_WIN_SCORE + depth
+                     : 0.0f;
+            found = true;
+        } else if (piece_count <= egtb::max_pieces() && egtb::probe_dtm(cr, dtm_wdl, mate_plies)) {
+            tb_score = dtm_wdl == egtb::WIN ? TB_WIN_SCORE - depth - mate_plies
+                     : dtm_wdl == egtb::LOSS ? -TB_WIN_SCORE + depth + mate_plies
+                     : 0.0f;
+            found = true;
+        }
+        if (found) {
+            if (!cr.WhiteToPlay()) {
+                tb_score = -tb_score;
+            }
+            thc::Move no_move;
+            no_move.Invalid();
+            store_tt(key, search_depth, tb_score, TTEntry::BOUND_EXACT, no_move);
+            return tb_score;
+        }
+    }
 
     if (depth == max_depth) {
-        debug_node_count++;
-        return static_eval(cr);
+        counters.leaves++;
+        bool exact;
+        Score eval = cached_static_eval(cr, key, entry, alpha_score, beta_score, exact);
+        if (!exact) {
+            return eval;
+        }
+
+        // Leaves only fill empty slots (depth -1), so transpositions find the score and the static eval
+        thc::Move no_move;
+        no_move.Invalid();
+        store_tt(key, 0, eval, TTEntry::BOUND_EXACT, no_move, eval);
+        return eval;
         // return quiesce(cr, alpha_score, beta_score);
     }
 
+    PERF_SWITCH(MOVEGEN);
     std::vector<thc::Move> legal_moves;
-    cr.GenLegalMoveList(legal_moves);
+    if (depth == 0 && !tb_root_moves.empty()) {
+        legal_moves = tb_root_moves;
+    } else {
+        cr.GenLegalMoveList(legal_moves);
+    }
 
     if (legal_moves.empty()) {
         // No legal moves: checkmate or stalemate? Shouldn't go here.
@@ -864,21 +1313,24 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
     }
 
     // Score moves
+    PERF_SWITCH(ORDERING);
     std::vector<std::pair<float, thc::Move>> scored_moves;
     for (auto &m : legal_moves) {
-        scored_moves.emplace_back(score_move(m, cr), m);
+        scored_moves.emplace_back(is_white_player ? score_move<WHITE>(m, cr) : score_move<BLACK>(m, cr), m);
     }
     std::sort(scored_moves.begin(), scored_moves.end(), [](auto &a, auto &b){
         return a.first > b.first;
     });
+    PERF_SWITCH(SEARCH);
 
     Score best_score = is_white_player ? -INF_SCORE : INF_SCORE;
 
     thc::Move local_best;
+    int move_index = 0;
     for (auto &entrymv : scored_moves) {
-        cr.PushMove(entrymv.second);
+        push_move(cr, entrymv.second);
         Score current_score = solve_serial_engine(cr, !is_white_player, best_move, depth + 1, max_depth, alpha_score, beta_score);
-        cr.PopMove(entrymv.second);
+        pop_move(cr, entrymv.second);
 
         if (time_limit_reached) {
             return 0.0f;
@@ -891,6 +1343,7 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
                 alpha_score = std::max(alpha_score, best_score);
             }
             if (alpha_score >= beta_score) {
+                count_cutoff(move_index);
                 break;
             }
         } else {
@@ -900,9 +1353,11 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
                 beta_score = std::min(beta_score, best_score);
             }
             if (beta_score <= alpha_score) {
+                count_cutoff(move_index);
                 break;
             }
         }
+        move_index++;
     }
 
     // Store to TT
@@ -913,7 +1368,7 @@ SerialEngine::Score SerialEngine::solve_serial_engine(
     else if (best_score >= beta_score) bound = TTEntry::BOUND_LOWER;
 
     // Use search_depth instead of depth when storing
-    store_tt(key, search_depth, (int)best_score, bound, local_best);
+    store_tt(key, search_depth, best_score, bound, local_best);
     if (depth == 0) best_move = local_best;
 
     return best_score;
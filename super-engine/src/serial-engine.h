@@ -2,23 +2,78 @@
 #define SERIAL_ENGINE_H
 
 #include "thc.h"      // Include the THC library header
+#include "nnue.h"
+#include "polyglot.h"
+#include "bitboard.h"
+#include "search-stats.h"
+#include <algorithm>
 #include <chrono>
 #include <atomic>
 #include <vector>     // For std::vector
 #include <cstdint>
 #include <random>
+#include <iostream>
+#include <ostream>
+#include <string>
 
 class SerialEngine {
 public:
     using Score = float;
 
+    // Which static evaluation the search uses
+    enum class EvalMode { CLASSICAL, NNUE };
+
     SerialEngine();
     ~SerialEngine();
 
     // Solve function to find the best move
     thc::Move solve(thc::ChessRules& cr, bool is_white_player);
 
+    // Static eval of a position on its own, outside a search (White's point of view, in centipawns)
+    Score evaluate(thc::ChessRules& cr);
+
+    // Use the Syzygy tablebases in path (directories separated by ':'), returns the largest piece count found.
+    // Always 0 (no tables) unless built with make SYZYGY=1.
+    int set_syzygy_path(const std::string& path);
+
+    // Use the distance to mate tables from tbgen in path (directories separated by ':'), returns the largest
+    // piece count found
+    int set_egtb_path(const std::string& path);
+
+    // Play from a Polyglot book while the game is shorter than max_ply plies. False (no book) if the file
+    // can't be mapped.
+    bool set_book(const std::string& path, int max_ply);
+
+    // Load an NNUE network file and switch to NNUE evaluation. Keeps the current mode on failure.
+    bool load_network(const std::string& path);
+
+    // Select the evaluation, NNUE is only used once a network is loaded
+    void set_eval_mode(EvalMode mode);
+    EvalMode get_eval_mode() const { return eval_mode; }
+
+    // How far outside the search window the cheap eval terms must be before the rest of the classical
+    // eval is skipped, blended by game phase like the piece-square tables. INF_SCORE turns it off.
+    void set_lazy_eval_margins(Score middlegame, Score endgame);
+
+    // Counters of the last solve() (empty after a book move)
+    const SearchStats& search_stats() const { return last_stats; }
+
+    // Write the stats of every search to out as one JSON line, nullptr to stop
+    void set_stats_output(std::ostream* out) { stats_output = out; }
+
+    // Where solve() reports book moves and each finished iteration, std::cout by default, nullptr for none
+    void set_log_output(std::ostream* out) { log_output = out; }
+
+    // Deepest iteration of a search
+    static constexpr int MAX_DEPTH = 8;
+
+    // Stop iterative deepening after this depth (clamped to 1..MAX_DEPTH), for fixed depth benchmarks
+    void set_max_depth(int depth) { max_depth = std::max(1, std::min(depth, MAX_DEPTH)); }
+
 private:
+    // Times the move, key, TT and eval primitives below (bench/engine-bench.cpp)
+    friend struct EngineBench;
+
     // Recursive search function with alpha-beta pruning and iterative deepening
     Score solve_serial_engine(
         thc::ChessRules& cr,
@@ -31,31 +86,86 @@ private:
     );
 
     static constexpr Score INF_SCORE = 1000000.0f;
-    static constexpr int MAX_DEPTH = 8;
     static constexpr int TIME_LIMIT_SECONDS = 200; // Time limit in seconds
+    static constexpr int MAX_PLY = 128;            // Deepest ply (search + quiescence) we keep state for
+    static constexpr Score TB_WIN_SCORE = INF_SCORE / 2; // Tablebase wins, below any mate score
+
+    enum Color { WHITE = 0, BLACK = 1 };
+
+    // Evaluation terms that only depend on which pieces are where, maintained incrementally by push_move
+    struct EvalState {
+        int material[2];        // Non-king material by color
+        int psq_mg;             // Piece-square sum White minus Black, middlegame tables
+        int psq_eg;             // Same with the endgame tables
+        int phase;              // Non-pawn material weights, MAX_PHASE at the start, 0 with only pawns left
+        int piece_counts[12];   // Indexed like the Zobrist keys (P=0 ... k=11)
+        int pawn_files[2][8];   // Pawns per file by color
+        Bitboard pieces[12];    // Squares of each piece, same indexing as piece_counts
+        uint64_t pawn_key;      // Zobrist key of the pawns only, indexes the pawn hash
+    };
+
+    // Pawn structure results cached by pawn key. The structure rarely changes within a search, so most
+    // leaves find their pawns here instead of re-scoring them.
+    struct PawnEntry {
+        uint64_t key;
+        int score;                  // Pawn structure score, White minus Black
+        Bitboard passed[2];         // Passed pawns by color
+        uint8_t semi_open_files[2]; // Bit f set if the color has no pawn on file f
+        uint8_t open_files;         // Bit f set if there is no pawn at all on file f
+    };
+
+    static constexpr size_t PAWN_HASH_SIZE = 1 << 14;
 
-    // Static evaluation function
-    Score static_eval(thc::ChessRules& cr);
+    // Look up (or compute and store) the pawn structure for the state's pawns
+    const PawnEntry& probe_pawn_hash(const EvalState& state);
 
-    // Helper function to score moves for move ordering
+    static constexpr int MAX_PHASE = 24;
+
+    // Build the state from scratch and apply one piece appearing (sign 1) or disappearing (sign -1)
+    void init_eval_state(const thc::ChessRules& cr, EvalState& state);
+    void update_eval_state(EvalState& state, char piece, int square, int sign);
+
+    // Static evaluation function, dispatches on eval_mode. exact is cleared when the eval stopped early
+    // because the cheap terms already put the score outside (alpha, beta), the result is then only a bound.
+    Score static_eval(thc::ChessRules& cr, Score alpha, Score beta, bool& exact);
+
+    // Hand-written evaluation (material, piece-square tables, mobility, pawns, king)
+    Score classical_eval(thc::ChessRules& cr, Score alpha, Score beta, bool& exact);
+
+    // Exact win/draw score of king and pawn against king from the bitbase
+    Score kpk_eval(thc::ChessRules& cr, const EvalState& state);
+
+    // Network evaluation from the accumulator of the current ply
+    Score nnue_eval(thc::ChessRules& cr);
+
+    // Make/unmake a move in the search, keeping the per-ply eval state in sync
+    void push_move(thc::ChessRules& cr, thc::Move& move);
+    void pop_move(thc::ChessRules& cr, thc::Move& move);
+
+    // Helper function to score moves for move ordering. The color-dependent evaluation helpers below are
+    // templated on the side they score, so each side gets its own branch-free instantiation.
+    template <Color Us>
     float score_move(const thc::Move& move, thc::ChessRules& cr);
 
     // **Add the missing function declarations here**
 
     // Function to evaluate mobility
-    int evaluate_mobility(thc::ChessRules& cr, bool is_white, const std::vector<int>& piece_indices);
+    template <Color Us>
+    int evaluate_mobility(const EvalState& state);
 
     // Function to evaluate pawn structure
-    int evaluate_pawn_structure(const std::vector<int>& pawn_files, bool is_white);
+    int evaluate_pawn_structure(const int file_counts[8], bool is_white);
 
     // Function to evaluate king safety
-    int evaluate_king_safety(thc::ChessRules& cr, int king_index, bool is_white, bool endgame);
+    template <Color Us>
+    int evaluate_king_safety(thc::ChessRules& cr, int king_index, bool endgame, const PawnEntry& pawns);
 
     // Function to detect endgame phase
     bool is_endgame(int white_material, int black_material);
 
     // Function to evaluate king activity in endgame
-    int evaluate_king_activity(int own_king_index, int opponent_king_index, bool is_white);
+    template <Color Us>
+    int evaluate_king_activity(int own_king_index, int opponent_king_index);
 
     Score quiesce(thc::ChessRules &cr, Score alpha, Score beta);
 
@@ -70,15 +180,70 @@ private:
     struct TTEntry {
         uint64_t key;
         int depth;
-        int score;
+        Score score;
         thc::Move best_move;
         enum BoundType { BOUND_EXACT, BOUND_LOWER, BOUND_UPPER } bound;
+        Score eval;     // Static eval of the position, NO_EVAL until one is computed
     };
 
+    static constexpr Score NO_EVAL = -2 * INF_SCORE;
+
     static constexpr size_t TT_SIZE = 1 << 20; 
     std::vector<TTEntry> transposition_table { TT_SIZE };
 
 
+    // NNUE state: the network, one accumulator per ply from the root and the pieces each move changed.
+    // Accumulators are only brought up to date when nnue_eval needs them.
+    EvalMode eval_mode = EvalMode::CLASSICAL;
+    nnue::Network network;
+    std::vector<nnue::Accumulator> accumulator_stack { MAX_PLY };
+    std::vector<nnue::DirtyPieces> dirty_stack { MAX_PLY };
+    nnue::RefreshCache refresh_cache;
+    int ply = 0;
+
+    // Classical eval state per ply, kept up to date eagerly since each move only costs a few additions
+    std::vector<EvalState> eval_stack { MAX_PLY };
+
+    // Pawn hash of this search thread
+    std::vector<PawnEntry> pawn_hash_table { PAWN_HASH_SIZE };
+
+    // Static evals of recently seen positions by Zobrist key, owned by the search thread
+    struct EvalCacheEntry {
+        uint64_t key;
+        Score eval;
+    };
+
+    static constexpr size_t EVAL_CACHE_SIZE = 1 << 16;
+    std::vector<EvalCacheEntry> eval_cache { EVAL_CACHE_SIZE };
+
+    // Eval time is sampled on every EVAL_TIMING_INTERVAL-th computation to estimate the time the TT and
+    // eval cache save
+    static constexpr uint64_t EVAL_TIMING_INTERVAL = 64;
+
+    // Lazy eval margins
+    Score lazy_margin_mg = 300.0f;
+    Score lazy_margin_eg = 200.0f;
+
+    // Counters of this search thread for the current iteration, added to last_stats as each one ends
+    SearchCounters counters;
+    SearchStats last_stats;
+    std::ostream* stats_output = nullptr;
+    std::ostream* log_output = &std::cout;
+    int max_depth = MAX_DEPTH;
+
+    void count_cutoff(int move_index) {
+        counters.beta_cutoffs++;
+        counters.cutoffs_by_move[std::min(move_index, SearchCounters::CUTOFF_BUCKETS - 1)]++;
+    }
+
+    // Root moves left after the tablebase DTZ filter, empty outside tablebase range
+    std::vector<thc::Move> tb_root_moves;
+
+    // Opening book, consulted before searching. Fixed seed so games are reproducible.
+    book::Book opening_book;
+    int book_max_ply = 0;
+    std::mt19937_64 book_rng {20240101ULL};
+
     // Time management variables
     std::chrono::steady_clock::time_point start_time;
     std::atomic<bool> time_limit_reached;
@@ -87,7 +252,14 @@ private:
     uint64_t compute_zobrist_key(const thc::ChessRules& cr);
     void init_transposition_table();
     TTEntry* probe_tt(uint64_t key);
-    void store_tt(uint64_t key, int depth, int score, TTEntry::BoundType bound, const thc::Move& best_move);
+    void store_tt(uint64_t key, int depth, Score score, TTEntry::BoundType bound, const thc::Move& best_move,
+                  Score eval = NO_EVAL);
+
+    // Static eval served from the TT entry (may be null) or the eval cache when the position was seen before.
+    // A lazy (inexact) eval is not cached, exact tells the caller which one it got.
+    Score cached_static_eval(thc::ChessRules& cr, uint64_t key, TTEntry* entry, Score alpha, Score beta,
+                             bool& exact);
+    void clear_eval_caches();
 };
 
 #endif // SERIAL_ENGINE_H
@@ -0,0 +1,193 @@
+/*
+ *  tbcheck
+ *
+ *  Cross-checks the Syzygy decoder (syzygy/tbprobe.h) against the distance to mate tables from tbgen on
+ *  random positions of each material set. Both sets of tables must cover the material.
+ *
+ *      make tbcheck
+ *      ./tbgen -o tables KRvK KQvKR
+ *      ./tbcheck --syzygy <syzygy dir> --egtb tables [-n <positions>] [--seed N] KRvK KQvKR
+ *
+ *  The DTM tables ignore the 50 move rule, so a Syzygy win or cursed win must be a DTM win, a loss or
+ *  blessed loss a DTM loss and a draw a draw. DTZ must have the sign of the WDL and be beyond +-100 exactly
+ *  for cursed wins and blessed losses. In a won position every root move Syzygy keeps must keep the DTM
+ *  win. Prints the first mismatches as FEN and returns 1 if there were any or nothing could be probed.
+ */
+
+#include "egtb.h"
+#include "index.h"
+#include "options.h"
+#include "tbprobe.h"
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int MAX_REPORTED = 10;
+
+struct Counts {
+    uint64_t checked = 0;
+    uint64_t unprobed = 0;
+    uint64_t mismatches = 0;
+};
+
+// FEN of a decoded placement, empty if two pieces share a square (pawns only avoid other pawns)
+std::string fen_of(const egtb::Material& m, const egtb::Placement& p) {
+    char board[64] = {};
+    for (int i = 0; i < m.count(); i++) {
+        if (board[p.squares[i]]) return "";
+        board[p.squares[i]] = m.pieces[i];
+    }
+
+    std::string fen;
+    for (int rank = 0; rank < 8; rank++) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            char piece = board[rank * 8 + file];
+            if (!piece) {
+                empty++;
+                continue;
+            }
+            if (empty) fen += char('0' + empty);
+            empty = 0;
+            fen += piece;
+        }
+        if (empty) fen += char('0' + empty);
+        if (rank < 7) fen += '/';
+    }
+    return fen + (p.black_to_move ? " b - - 0 1" : " w - - 0 1");
+}
+
+bool agrees(syzygy::WDL wdl, egtb::WDL dtm) {
+    switch (wdl) {
+    case syzygy::WIN:
+    case syzygy::CURSED_WIN:
+        return dtm == egtb::WIN;
+    case syzygy::LOSS:
+    case syzygy::BLESSED_LOSS:
+        return dtm == egtb::LOSS;
+    default:
+        return dtm == egtb::DRAW;
+    }
+}
+
+bool dtz_agrees(syzygy::WDL wdl, int dtz) {
+    switch (wdl) {
+    case syzygy::WIN:          return dtz > 0 && dtz <= 100;
+    case syzygy::CURSED_WIN:   return dtz > 100;
+    case syzygy::LOSS:         return dtz < 0 && dtz >= -100;
+    case syzygy::BLESSED_LOSS: return dtz < -100;
+    default:                   return dtz == 0;
+    }
+}
+
+// Check one position, false (with a line on cout) on a mismatch
+bool check(thc::ChessRules& cr, const std::string& fen, Counts& counts) {
+    syzygy::WDL wdl;
+    int dtz;
+    egtb::WDL dtm;
+    int plies;
+    if (!syzygy::probe_wdl(cr, wdl) || !syzygy::probe_dtz(cr, dtz) || !egtb::probe_dtm(cr, dtm, plies)) {
+        counts.unprobed++;
+        return true;
+    }
+    counts.checked++;
+
+    std::string problem;
+    if (!agrees(wdl, dtm)) {
+        problem = "wdl " + std::to_string(int(wdl)) + " but dtm result " + std::to_string(int(dtm));
+    } else if (!dtz_agrees(wdl, dtz)) {
+        problem = "wdl " + std::to_string(int(wdl)) + " but dtz " + std::to_string(dtz);
+    } else if (wdl == syzygy::WIN) {
+        std::vector<thc::Move> moves;
+        cr.GenLegalMoveList(moves);
+        if (syzygy::filter_root_moves(cr, moves)) {
+            for (thc::Move& move : moves) {
+                cr.PushMove(move);
+                bool lost = egtb::probe_dtm(cr, dtm, plies) && dtm == egtb::LOSS;
+                cr.PopMove(move);
+                if (!lost) {
+                    problem = "root move " + move.TerseOut() + " gives up the win";
+                    break;
+                }
+            }
+        } else {
+            problem = "root moves could not be filtered";
+        }
+    }
+
+    if (problem.empty()) return true;
+    if (++counts.mismatches <= MAX_REPORTED) {
+        std::cout << "  " << fen << ": " << problem << std::endl;
+    }
+    return false;
+}
+
+bool check_material(const std::string& name, uint64_t positions, std::mt19937_64& rng) {
+    egtb::Material m;
+    if (!egtb::Material::parse(name, m) || m.count() < egtb::MIN_PIECES) {
+        std::cout << name << ": not a material set with " << egtb::MIN_PIECES << "-" << egtb::MAX_PIECES
+                  << " pieces" << std::endl;
+        return false;
+    }
+
+    Counts counts;
+    std::uniform_int_distribution<uint64_t> pick(0, m.size() - 1);
+    uint64_t tries = 0;
+    while (counts.checked + counts.unprobed < positions && tries++ < positions * 100) {
+        std::string fen = fen_of(m, egtb::decode(m, pick(rng)));
+        thc::ChessRules cr;
+        thc::ILLEGAL_REASON reason;
+        if (fen.empty() || !cr.Forsyth(fen.c_str()) || !cr.IsLegal(reason)) continue;
+        check(cr, fen, counts);
+    }
+
+    std::cout << name << ": " << counts.checked << " positions checked, " << counts.unprobed
+              << " not covered by both tables, " << counts.mismatches << " mismatches" << std::endl;
+    return counts.checked > 0 && counts.mismatches == 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string syzygy_path, egtb_path;
+    uint64_t positions = 100000;
+    uint64_t seed = 1;
+    std::vector<std::string> materials;
+    bool usage = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--syzygy" && i + 1 < argc) {
+            syzygy_path = argv[++i];
+        } else if (arg == "--egtb" && i + 1 < argc) {
+            egtb_path = argv[++i];
+        } else if (arg == "-n" && i + 1 < argc && parse_unsigned(argv[i + 1], positions) && positions > 0) {
+            i++;
+        } else if (arg == "--seed" && i + 1 < argc && parse_unsigned(argv[i + 1], seed)) {
+            i++;
+        } else if (!arg.empty() && arg[0] != '-') {
+            materials.push_back(arg);
+        } else {
+            usage = true;
+        }
+    }
+    if (usage || syzygy_path.empty() || egtb_path.empty() || materials.empty()) {
+        std::cout << "Usage: " << argv[0] << " --syzygy <dir> --egtb <dir> [-n <positions>] [--seed <n>]"
+                  << " <material>..." << std::endl;
+        return 1;
+    }
+    if (syzygy::init(syzygy_path) == 0 || egtb::init(egtb_path) == 0) {
+        std::cout << "No tables in " << (syzygy::max_pieces() == 0 ? syzygy_path : egtb_path) << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 rng(seed);
+    bool ok = true;
+    for (const std::string& name : materials) {
+        ok = check_material(name, positions, rng) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,923 @@
+#include "tbprobe.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace syzygy {
+
+namespace {
+
+// Squares in this file are the tablebase ones, a1 = 0 and h8 = 63 (thc's squares flipped vertically).
+// Pieces use the table encoding: 1-6 PNBRQK for White, 9-14 for Black.
+constexpr int TB_PIECES = 7;
+constexpr int PAWN = 1;
+constexpr int KING = 6;
+constexpr int BLACK_BIT = 8;
+
+int file_of(int sq) { return sq & 7; }
+int rank_of(int sq) { return sq >> 3; }
+int flip_file(int sq) { return sq ^ 7; }
+int flip_rank(int sq) { return sq ^ 56; }
+int off_a1h8(int sq) { return rank_of(sq) - file_of(sq); }
+int edge_distance(int file) { return std::min(file, 7 - file); }
+
+int piece_code(char c) {
+    switch (c) {
+        case 'P': return 1; case 'N': return 2; case 'B': return 3;
+        case 'R': return 4; case 'Q': return 5; case 'K': return 6;
+        case 'p': return 9; case 'n': return 10; case 'b': return 11;
+        case 'r': return 12; case 'q': return 13; case 'k': return 14;
+        default: return 0;
+    }
+}
+
+// Encoding tables, filled once by init_encoding
+int MapB1H1H7[64];
+int MapA1D1D4[64];
+int MapKK[10][64];
+uint64_t Binomial[6][64];
+int MapPawns[64];
+int LeadPawnIdx[6][64];
+int LeadPawnsSize[6][4];
+
+bool pawns_comp(int a, int b) {
+    return MapPawns[a] < MapPawns[b];
+}
+
+void init_encoding() {
+    int code = 0;
+    for (int s = 0; s < 64; s++) {
+        if (off_a1h8(s) < 0) MapB1H1H7[s] = code++;
+    }
+
+    // The a1-d1-d4 triangle below the diagonal first, the diagonal squares last
+    std::vector<int> diagonal;
+    code = 0;
+    for (int s = 0; s <= 27; s++) {
+        if (off_a1h8(s) < 0 && file_of(s) <= 3) MapA1D1D4[s] = code++;
+        else if (!off_a1h8(s) && file_of(s) <= 3) diagonal.push_back(s);
+    }
+    for (int s : diagonal) MapA1D1D4[s] = code++;
+
+    // The 462 legal placements of two kings with the first one in the triangle, those with both kings on
+    // the diagonal last
+    std::vector<std::pair<int, int>> both_on_diagonal;
+    code = 0;
+    for (int idx = 0; idx < 10; idx++) {
+        for (int s1 = 0; s1 <= 27; s1++) {
+            if (MapA1D1D4[s1] != idx || (idx == 0 && s1 != 1)) continue;
+            for (int s2 = 0; s2 < 64; s2++) {
+                int files = std::abs(file_of(s1) - file_of(s2));
+                int ranks = std::abs(rank_of(s1) - rank_of(s2));
+                if (files <= 1 && ranks <= 1) continue;
+                if (!off_a1h8(s1) && off_a1h8(s2) > 0) continue;
+                if (!off_a1h8(s1) && !off_a1h8(s2)) both_on_diagonal.emplace_back(idx, s2);
+                else MapKK[idx][s2] = code++;
+            }
+        }
+    }
+    for (auto& p : both_on_diagonal) MapKK[p.first][p.second] = code++;
+
+    Binomial[0][0] = 1;
+    for (int n = 1; n < 64; n++) {
+        for (int k = 0; k < 6 && k <= n; k++) {
+            Binomial[k][n] = (k > 0 ? Binomial[k - 1][n - 1] : 0) + (k < n ? Binomial[k][n - 1] : 0);
+        }
+    }
+
+    // MapPawns ranks a2-h7 so that the leading pawn (nearest the edge, then lowest) has the highest value
+    int available = 47;
+    for (int lead = 1; lead <= 5; lead++) {
+        for (int f = 0; f <= 3; f++) {
+            int idx = 0;
+            for (int r = 1; r <= 6; r++) {
+                int sq = r * 8 + f;
+                if (lead == 1) {
+                    MapPawns[sq] = available--;
+                    MapPawns[flip_file(sq)] = available--;
+                }
+                LeadPawnIdx[lead][sq] = idx;
+                idx += Binomial[lead - 1][MapPawns[sq]];
+            }
+            LeadPawnsSize[lead][f] = idx;
+        }
+    }
+}
+
+template <typename T>
+T read_le(const uint8_t* p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+uint32_t read_be32(const uint8_t* p) {
+    return __builtin_bswap32(read_le<uint32_t>(p));
+}
+
+uint64_t read_be64(const uint8_t* p) {
+    return __builtin_bswap64(read_le<uint64_t>(p));
+}
+
+enum TableFlag { STM = 1, MAPPED = 2, WIN_PLIES = 4, LOSS_PLIES = 8, WIDE = 16, SINGLE_VALUE = 128 };
+
+// Left and right child of a symbol, two 12 bit values in 3 bytes
+struct SymbolPair {
+    uint8_t lr[3];
+    int left() const { return ((lr[1] & 0xF) << 8) | lr[0]; }
+    int right() const { return (lr[2] << 4) | (lr[1] >> 4); }
+};
+
+static_assert(sizeof(SymbolPair) == 3, "SymbolPair must be packed");
+
+// Values are stored in blocks of canonical Huffman codes, each symbol standing for a pair of shorter
+// symbols down to single values ("recursive pairing"). The sparse index gives the block of every span-th
+// value, the block lengths find the exact one.
+struct PairsData {
+    uint8_t flags = 0;
+    uint64_t block_size = 0;
+    uint64_t span = 0;
+    uint32_t num_blocks = 0;
+    int max_sym_len = 0;
+    int min_sym_len = 0;
+    const uint8_t* lowest_sym = nullptr;    // uint16 per length
+    const SymbolPair* btree = nullptr;
+    const uint8_t* block_length = nullptr;  // uint16 per block
+    uint32_t block_length_size = 0;
+    const uint8_t* sparse_index = nullptr;  // 6 bytes per entry: uint32 block, uint16 offset
+    uint64_t sparse_index_size = 0;
+    const uint8_t* data = nullptr;
+    std::vector<uint64_t> base64;
+    std::vector<uint8_t> symlen;
+    int pieces[TB_PIECES] = {};
+    uint64_t group_idx[TB_PIECES + 1] = {};
+    int group_len[TB_PIECES + 1] = {};
+    uint16_t map_idx[4] = {};               // DTZ value maps for win, loss, cursed win, blessed loss
+};
+
+enum TableType { WDL_TABLE = 0, DTZ_TABLE = 1 };
+
+const uint8_t MAGIC[2][4] = {{0x71, 0xE8, 0x23, 0x5D}, {0xD7, 0x66, 0x0C, 0xA5}};
+const char* const SUFFIX[2] = {".rtbw", ".rtbz"};
+
+// One file of a table, mapped on first use
+struct TableFile {
+    std::atomic<bool> ready {false};
+    bool failed = false;
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    const uint8_t* dtz_map = nullptr;
+    PairsData items[2][4];      // [side][file of the leading pawn]
+
+    PairsData* get(int stm, int file, bool has_pawns, int sides) {
+        return &items[stm % sides][has_pawns ? file : 0];
+    }
+};
+
+// A material combination like KRvK. key is its material key, key2 the one with the colors swapped.
+struct Table {
+    std::string name;
+    std::string directory;
+    uint64_t key = 0;
+    uint64_t key2 = 0;
+    int piece_count = 0;
+    bool has_pawns = false;
+    bool has_unique_pieces = false;
+    int pawn_count[2] = {};     // Leading color first
+    bool has_file[2] = {};
+    TableFile files[2];         // WDL, DTZ
+};
+
+// Pieces per side of a position, with a key built from the counts of each piece
+uint64_t material_key(const int counts[16]) {
+    uint64_t key = 0;
+    for (int p = 0; p < 16; p++) {
+        key |= uint64_t(counts[p]) << (4 * p);
+    }
+    return key;
+}
+
+uint64_t swapped_key(const int counts[16]) {
+    int swapped[16] = {};
+    for (int p = 0; p < 16; p++) {
+        swapped[p ^ BLACK_BIT] = counts[p];
+    }
+    return material_key(swapped);
+}
+
+std::vector<std::unique_ptr<Table>> tables;
+std::unordered_map<uint64_t, Table*> tables_by_key;
+std::mutex map_mutex;
+int largest = 0;
+thread_local Stats probe_stats;   // Each search thread counts its own probes
+
+bool register_table(const std::string& directory, const std::string& name, TableType type) {
+    size_t v = name.find('v');
+    if (v == std::string::npos || name[0] != 'K' || name.size() - 1 > TB_PIECES) {
+        return false;
+    }
+
+    int counts[16] = {};
+    for (size_t i = 0; i < name.size(); i++) {
+        if (i == v) continue;
+        int code = piece_code(name[i]);
+        if (!code) return false;
+        counts[code | (i > v ? BLACK_BIT : 0)]++;
+    }
+
+    uint64_t key = material_key(counts);
+    auto found = tables_by_key.find(key);
+    if (found != tables_by_key.end() && found->second->name == name) {
+        found->second->has_file[type] = true;
+        return true;
+    }
+    if (found != tables_by_key.end()) {
+        return false;   // Same material under another name
+    }
+
+    auto table = std::make_unique<Table>();
+    table->name = name;
+    table->directory = directory;
+    table->key = key;
+    table->key2 = swapped_key(counts);
+    table->has_file[type] = true;
+    for (int p = 0; p < 16; p++) {
+        table->piece_count += counts[p];
+        if (p % 8 != 0 && p % 8 != KING && counts[p] == 1) table->has_unique_pieces = true;
+    }
+    int white_pawns = counts[PAWN];
+    int black_pawns = counts[PAWN | BLACK_BIT];
+    table->has_pawns = white_pawns + black_pawns > 0;
+
+    // The leading color is the one with fewer pawns (but some), that compresses better
+    bool white_leads = !black_pawns || (white_pawns && black_pawns >= white_pawns);
+    table->pawn_count[0] = white_leads ? white_pawns : black_pawns;
+    table->pawn_count[1] = white_leads ? black_pawns : white_pawns;
+
+    largest = std::max(largest, table->piece_count);
+    tables_by_key[table->key] = table.get();
+    tables_by_key[table->key2] = table.get();
+    tables.push_back(std::move(table));
+    return true;
+}
+
+void release_tables() {
+    for (auto& table : tables) {
+        for (auto& file : table->files) {
+            if (file.base) {
+                munmap(const_cast<uint8_t*>(file.base), file.size);
+            }
+        }
+    }
+    tables.clear();
+    tables_by_key.clear();
+    largest = 0;
+}
+
+// Piece groups of a table and the index multiplier of each, see do_probe for how they are encoded
+void set_groups(const Table& e, PairsData* d, const int order[2], int f) {
+    int n = 0;
+    int first_len = e.has_pawns ? 0 : e.has_unique_pieces ? 3 : 2;
+    d->group_len[n] = 1;
+    for (int i = 1; i < e.piece_count; i++) {
+        if (--first_len > 0 || d->pieces[i] == d->pieces[i - 1]) d->group_len[n]++;
+        else d->group_len[++n] = 1;
+    }
+    d->group_len[++n] = 0;
+
+    bool pp = e.has_pawns && e.pawn_count[1];
+    int next = pp ? 2 : 1;
+    int free_squares = 64 - d->group_len[0] - (pp ? d->group_len[1] : 0);
+    uint64_t idx = 1;
+
+    for (int k = 0; next < n || k == order[0] || k == order[1]; k++) {
+        if (k == order[0]) {
+            d->group_idx[0] = idx;
+            idx *= e.has_pawns ? LeadPawnsSize[d->group_len[0]][f] : e.has_unique_pieces ? 31332 : 462;
+        } else if (k == order[1]) {
+            d->group_idx[1] = idx;
+            idx *= Binomial[d->group_len[1]][48 - d->group_len[0]];
+        } else {
+            d->group_idx[next] = idx;
+            idx *= Binomial[d->group_len[next]][free_squares];
+            free_squares -= d->group_len[next++];
+        }
+    }
+    d->group_idx[n] = idx;
+}
+
+// Length (number of values - 1) that a symbol expands to
+uint8_t set_symlen(PairsData* d, int s, std::vector<bool>& visited) {
+    visited[s] = true;
+    int sr = d->btree[s].right();
+    if (sr == 0xFFF) return 0;
+    int sl = d->btree[s].left();
+    if (!visited[sl]) d->symlen[sl] = set_symlen(d, sl, visited);
+    if (!visited[sr]) d->symlen[sr] = set_symlen(d, sr, visited);
+    return d->symlen[sl] + d->symlen[sr] + 1;
+}
+
+const uint8_t* set_sizes(PairsData* d, const uint8_t* data) {
+    d->flags = *data++;
+    if (d->flags & SINGLE_VALUE) {
+        d->num_blocks = 0;
+        d->span = 0;
+        d->block_length_size = 0;
+        d->sparse_index_size = 0;
+        d->min_sym_len = *data++;   // The single value
+        return data;
+    }
+
+    uint64_t tb_size = d->group_idx[std::find(d->group_len, d->group_len + TB_PIECES, 0) - d->group_len];
+    d->block_size = uint64_t(1) << *data++;
+    d->span = uint64_t(1) << *data++;
+    d->sparse_index_size = (tb_size + d->span - 1) / d->span;
+    int padding = *data++;
+    d->num_blocks = read_le<uint32_t>(data);
+    data += 4;
+    d->block_length_size = d->num_blocks + padding;
+    d->max_sym_len = *data++;
+    d->min_sym_len = *data++;
+    d->lowest_sym = data;
+
+    // Canonical Huffman code: the lowest code of each length, left aligned in 64 bits
+    d->base64.assign(d->max_sym_len - d->min_sym_len + 1, 0);
+    for (int i = int(d->base64.size()) - 2; i >= 0; i--) {
+        d->base64[i] = (d->base64[i + 1] + read_le<uint16_t>(d->lowest_sym + 2 * i)
+                        - read_le<uint16_t>(d->lowest_sym + 2 * (i + 1))) / 2;
+    }
+    for (size_t i = 0; i < d->base64.size(); i++) {
+        d->base64[i] <<= 64 - i - d->min_sym_len;
+    }
+    data += d->base64.size() * 2;
+
+    d->symlen.assign(read_le<uint16_t>(data), 0);
+    data += 2;
+    d->btree = reinterpret_cast<const SymbolPair*>(data);
+
+    std::vector<bool> visited(d->symlen.size());
+    for (size_t s = 0; s < d->symlen.size(); s++) {
+        if (!visited[s]) d->symlen[s] = set_symlen(d, int(s), visited);
+    }
+    return data + d->symlen.size() * sizeof(SymbolPair) + (d->symlen.size() & 1);
+}
+
+const uint8_t* set_dtz_map(Table& e, TableFile& file, const uint8_t* data, int max_file) {
+    file.dtz_map = data;
+    for (int f = 0; f <= max_file; f++) {
+        PairsData* d = file.get(0, f, e.has_pawns, 1);
+        if (!(d->flags & MAPPED)) continue;
+        if (d->flags & WIDE) {
+            data += reinterpret_cast<uintptr_t>(data) & 1;
+            for (int i = 0; i < 4; i++) {
+                d->map_idx[i] = uint16_t((data - file.dtz_map) / 2 + 1);
+                data += 2 * read_le<uint16_t>(data) + 2;
+            }
+        } else {
+            for (int i = 0; i < 4; i++) {
+                d->map_idx[i] = uint16_t(data - file.dtz_map + 1);
+                data += *data + 1;
+            }
+        }
+    }
+    return data + (reinterpret_cast<uintptr_t>(data) & 1);
+}
+
+// Parse the table header: piece order and groups, then the sizes and offsets of each sub-table
+void init_table(Table& e, TableFile& file, TableType type, const uint8_t* data) {
+    data++;     // Flags (split, has pawns), already known from the name
+
+    int sides = type == WDL_TABLE && e.key != e.key2 ? 2 : 1;
+    int max_file = e.has_pawns ? 3 : 0;
+    bool pp = e.has_pawns && e.pawn_count[1];
+
+    for (int f = 0; f <= max_file; f++) {
+        for (int i = 0; i < sides; i++) {
+            *file.get(i, f, e.has_pawns, sides) = PairsData();
+        }
+        int order[2][2] = {{*data & 0xF, pp ? *(data + 1) & 0xF : 0xF},
+                           {*data >> 4, pp ? *(data + 1) >> 4 : 0xF}};
+        data += 1 + pp;
+        for (int k = 0; k < e.piece_count; k++, data++) {
+            for (int i = 0; i < sides; i++) {
+                file.get(i, f, e.has_pawns, sides)->pieces[k] = i ? *data >> 4 : *data & 0xF;
+            }
+        }
+        for (int i = 0; i < sides; i++) {
+            set_groups(e, file.get(i, f, e.has_pawns, sides), order[i], f);
+        }
+    }
+    data += reinterpret_cast<uintptr_t>(data) & 1;
+
+    for (int f = 0; f <= max_file; f++)
+        for (int i = 0; i < sides; i++)
+            data = set_sizes(file.get(i, f, e.has_pawns, sides), data);
+
+    if (type == DTZ_TABLE) {
+        data = set_dtz_map(e, file, data, max_file);
+    }
+
+    for (int f = 0; f <= max_file; f++)
+        for (int i = 0; i < sides; i++) {
+            PairsData* d = file.get(i, f, e.has_pawns, sides);
+            d->sparse_index = data;
+            data += d->sparse_index_size * 6;
+        }
+    for (int f = 0; f <= max_file; f++)
+        for (int i = 0; i < sides; i++) {
+            PairsData* d = file.get(i, f, e.has_pawns, sides);
+            d->block_length = data;
+            data += d->block_length_size * 2;
+        }
+    for (int f = 0; f <= max_file; f++)
+        for (int i = 0; i < sides; i++) {
+            PairsData* d = file.get(i, f, e.has_pawns, sides);
+            data = reinterpret_cast<const uint8_t*>((reinterpret_cast<uintptr_t>(data) + 0x3F) & ~uintptr_t(0x3F));
+            d->data = data;
+            data += uint64_t(d->num_blocks) * d->block_size;
+        }
+}
+
+// Map and parse the file on first use, later calls only check the flag
+bool map_file(Table& e, TableType type) {
+    TableFile& file = e.files[type];
+    if (file.ready.load(std::memory_order_acquire)) {
+        return !file.failed;
+    }
+
+    std::lock_guard<std::mutex> lock(map_mutex);
+    if (file.ready.load(std::memory_order_relaxed)) {
+        return !file.failed;
+    }
+
+    file.failed = true;
+    if (e.has_file[type]) {
+        std::string path = e.directory + "/" + e.name + SUFFIX[type];
+        int fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size % 64 == 16) {
+            void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (base != MAP_FAILED) {
+                file.base = static_cast<const uint8_t*>(base);
+                file.size = st.st_size;
+                if (std::memcmp(file.base, MAGIC[type], 4) == 0) {
+                    init_table(e, file, type, file.base + 4);
+                    file.failed = false;
+                }
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    file.ready.store(true, std::memory_order_release);
+    return !file.failed;
+}
+
+int decompress_pairs(const PairsData* d, uint64_t idx) {
+    if (d->flags & SINGLE_VALUE) {
+        return d->min_sym_len;
+    }
+
+    // Start from the sparse index entry nearest idx and walk the block lengths to the right block
+    uint64_t k = idx / d->span;
+    uint32_t block = read_le<uint32_t>(d->sparse_index + 6 * k);
+    int offset = read_le<uint16_t>(d->sparse_index + 6 * k + 4);
+    offset += int(idx % d->span) - int(d->span / 2);
+
+    while (offset < 0) offset += read_le<uint16_t>(d->block_length + 2 * --block) + 1;
+    while (offset > read_le<uint16_t>(d->block_length + 2 * block)) {
+        offset -= read_le<uint16_t>(d->block_length + 2 * block++) + 1;
+    }
+
+    const uint8_t* ptr = d->data + uint64_t(block) * d->block_size;
+    uint64_t buf64 = read_be64(ptr);
+    ptr += 8;
+    int buf64_size = 64;
+    int sym;
+
+    while (true) {
+        int len = 0;
+        while (buf64 < d->base64[len]) len++;
+        sym = int((buf64 - d->base64[len]) >> (64 - len - d->min_sym_len));
+        sym += read_le<uint16_t>(d->lowest_sym + 2 * len);
+        if (offset < d->symlen[sym] + 1) break;
+        offset -= d->symlen[sym] + 1;
+        len += d->min_sym_len;
+        buf64 <<= len;
+        buf64_size -= len;
+        if (buf64_size <= 32) {
+            buf64_size += 32;
+            buf64 |= uint64_t(read_be32(ptr)) << (64 - buf64_size);
+            ptr += 4;
+        }
+    }
+
+    // Expand the pair tree down to the single value at offset
+    while (d->symlen[sym]) {
+        int left = d->btree[sym].left();
+        if (offset < d->symlen[left] + 1) {
+            sym = left;
+        } else {
+            offset -= d->symlen[left] + 1;
+            sym = d->btree[sym].right();
+        }
+    }
+    return d->btree[sym].left();
+}
+
+// A position in tablebase terms
+struct Position {
+    int board[64];          // Piece code by square, 0 if empty
+    bool black_to_move;
+    int counts[16];
+    int piece_count;
+};
+
+void set_position(const thc::ChessRules& cr, Position& pos) {
+    std::memset(&pos, 0, sizeof(pos));
+    pos.black_to_move = !cr.white;
+    for (int s = 0; s < 64; s++) {
+        int code = piece_code(cr.squares[s]);
+        if (code) {
+            pos.board[s ^ 56] = code;
+            pos.counts[code]++;
+            pos.piece_count++;
+        }
+    }
+}
+
+enum ProbeState { FAIL, OK, CHANGE_STM, ZEROING_BEST_MOVE };
+
+int map_dtz_score(const Table& e, const TableFile& file, int f, int value, WDL wdl) {
+    constexpr int WDL_MAP[] = {1, 3, 0, 2, 0};
+    const PairsData* d = &file.items[0][e.has_pawns ? f : 0];
+    if (d->flags & MAPPED) {
+        int idx = d->map_idx[WDL_MAP[wdl + 2]] + value;
+        value = (d->flags & WIDE) ? read_le<uint16_t>(file.dtz_map + 2 * idx) : file.dtz_map[idx];
+    }
+    // Stored in moves unless flagged as plies, we want plies
+    if ((wdl == WIN && !(d->flags & WIN_PLIES)) || (wdl == LOSS && !(d->flags & LOSS_PLIES))
+        || wdl == CURSED_WIN || wdl == BLESSED_LOSS) {
+        value *= 2;
+    }
+    return value + 1;
+}
+
+// Index the position in the table and look it up. For DTZ, wdl selects the value map.
+int do_probe(const Position& pos, Table& e, TableType type, WDL wdl, ProbeState& result) {
+    TableFile& file = e.files[type];
+    int sides = type == WDL_TABLE && e.key != e.key2 ? 2 : 1;
+    int squares[TB_PIECES];
+    int pieces[TB_PIECES];
+    int size = 0;
+    int lead_pawns_count = 0;
+    int tb_file = 0;
+    uint64_t idx;
+
+    // The table stores the stronger side (the one in its name) as White. Symmetric tables only store
+    // White to move, so Black to move is flipped too.
+    bool symmetric_black_to_move = e.key == e.key2 && pos.black_to_move;
+    bool black_stronger = material_key(pos.counts) != e.key;
+    bool flip = symmetric_black_to_move || black_stronger;
+    int flip_color = flip ? BLACK_BIT : 0;
+    int flip_squares = flip ? 56 : 0;
+    int stm = flip ^ pos.black_to_move;
+
+    uint64_t lead_pawns = 0;
+    if (e.has_pawns) {
+        int pawn = file.items[0][0].pieces[0] ^ flip_color;
+        for (int s = 0; s < 64; s++) {
+            if (pos.board[s] == pawn) {
+                squares[size++] = s ^ flip_squares;
+                lead_pawns |= uint64_t(1) << s;
+            }
+        }
+        lead_pawns_count = size;
+        std::swap(squares[0], *std::max_element(squares, squares + lead_pawns_count, pawns_comp));
+        tb_file = edge_distance(file_of(squares[0]));
+    }
+
+    // DTZ tables hold one side to move only
+    if (type == DTZ_TABLE) {
+        int flags = file.items[0][e.has_pawns ? tb_file : 0].flags;
+        if ((flags & STM) != stm && !(e.key == e.key2 && !e.has_pawns)) {
+            result = CHANGE_STM;
+            return 0;
+        }
+    }
+
+    for (int s = 0; s < 64; s++) {
+        if (pos.board[s] && !(lead_pawns & (uint64_t(1) << s))) {
+            squares[size] = s ^ flip_squares;
+            pieces[size++] = pos.board[s] ^ flip_color;
+        }
+    }
+
+    PairsData* d = file.get(stm, tb_file, e.has_pawns, sides);
+
+    // Order the pieces like the table does
+    for (int i = lead_pawns_count; i < size - 1; i++) {
+        for (int j = i + 1; j < size; j++) {
+            if (d->pieces[i] == pieces[j]) {
+                std::swap(pieces[i], pieces[j]);
+                std::swap(squares[i], squares[j]);
+                break;
+            }
+        }
+    }
+
+    // The leading piece goes to files a-d
+    if (file_of(squares[0]) > 3) {
+        for (int i = 0; i < size; i++) squares[i] = flip_file(squares[i]);
+    }
+
+    if (e.has_pawns) {
+        idx = LeadPawnIdx[lead_pawns_count][squares[0]];
+        std::stable_sort(squares + 1, squares + lead_pawns_count, pawns_comp);
+        for (int i = 1; i < lead_pawns_count; i++) {
+            idx += Binomial[i][MapPawns[squares[i]]];
+        }
+    } else {
+        // Without pawns the board can also be flipped vertically and along the a1-h8 diagonal, bringing
+        // the leading piece into the a1-d1-d4 triangle
+        if (rank_of(squares[0]) > 3) {
+            for (int i = 0; i < size; i++) squares[i] = flip_rank(squares[i]);
+        }
+        for (int i = 0; i < d->group_len[0]; i++) {
+            if (!off_a1h8(squares[i])) continue;
+            if (off_a1h8(squares[i]) > 0) {
+                for (int j = i; j < size; j++) squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+            }
+            break;
+        }
+
+        if (e.has_unique_pieces) {
+            int adjust1 = squares[1] > squares[0];
+            int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+            if (off_a1h8(squares[0])) {
+                idx = (MapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2] - adjust2;
+            } else if (off_a1h8(squares[1])) {
+                idx = (6 * 63 + rank_of(squares[0]) * 28 + MapB1H1H7[squares[1]]) * 62 + squares[2] - adjust2;
+            } else if (off_a1h8(squares[2])) {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + rank_of(squares[0]) * 7 * 28
+                    + (rank_of(squares[1]) - adjust1) * 28 + MapB1H1H7[squares[2]];
+            } else {
+                idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + rank_of(squares[0]) * 7 * 6
+                    + (rank_of(squares[1]) - adjust1) * 6 + (rank_of(squares[2]) - adjust2);
+            }
+        } else {
+            idx = MapKK[MapA1D1D4[squares[0]]][squares[1]];
+        }
+    }
+
+    // Remaining groups, each as a combination of squares not taken by the groups before it
+    idx *= d->group_idx[0];
+    int* group_sq = squares + d->group_len[0];
+    bool remaining_pawns = e.has_pawns && e.pawn_count[1];
+    int next = 0;
+    while (d->group_len[++next]) {
+        std::stable_sort(group_sq, group_sq + d->group_len[next]);
+        uint64_t n = 0;
+        for (int i = 0; i < d->group_len[next]; i++) {
+            int adjust = int(std::count_if(squares, group_sq, [&](int s) { return group_sq[i] > s; }));
+            n += Binomial[i + 1][group_sq[i] - adjust - 8 * remaining_pawns];
+        }
+        remaining_pawns = false;
+        idx += n * d->group_idx[next];
+        group_sq += d->group_len[next];
+    }
+
+    int value = decompress_pairs(d, idx);
+    if (type == WDL_TABLE) {
+        return value - 2;
+    }
+    return map_dtz_score(e, file, tb_file, value, wdl);
+}
+
+int probe_table(const thc::ChessRules& cr, TableType type, ProbeState& result, WDL wdl = DRAW) {
+    Position pos;
+    set_position(cr, pos);
+    if (pos.piece_count == 2) {
+        return DRAW;    // KvK
+    }
+
+    auto found = tables_by_key.find(material_key(pos.counts));
+    if (found == tables_by_key.end() || !map_file(*found->second, type)) {
+        result = FAIL;
+        return 0;
+    }
+    return do_probe(pos, *found->second, type, wdl, result);
+}
+
+bool is_zeroing(const thc::ChessRules& cr, const thc::Move& move) {
+    return move.capture != ' ' || cr.squares[move.src] == 'P' || cr.squares[move.src] == 'p';
+}
+
+bool in_check(thc::ChessRules& cr) {
+    return cr.AttackedPiece(cr.white ? thc::Square(cr.wking_square) : thc::Square(cr.bking_square));
+}
+
+// Captures (and with check_zeroing, pawn moves) are searched instead of looked up, since the tables
+// don't know about en passant and a capture may be better than what the table says
+WDL search(thc::ChessRules& cr, ProbeState& result, bool check_zeroing) {
+    WDL best = LOSS;
+    std::vector<thc::Move> moves;
+    cr.GenLegalMoveList(moves);
+    size_t move_count = 0;
+
+    for (thc::Move& move : moves) {
+        bool pawn_move = cr.squares[move.src] == 'P' || cr.squares[move.src] == 'p';
+        if (move.capture == ' ' && (!check_zeroing || !pawn_move)) continue;
+        move_count++;
+        cr.PushMove(move);
+        WDL value = WDL(-search(cr, result, false));
+        cr.PopMove(move);
+        if (result == FAIL) return DRAW;
+        if (value > best) {
+            best = value;
+            if (value >= WIN) {
+                result = ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    // When every legal move was searched the table isn't needed (and may be wrong, e.g. for stalemates)
+    bool no_more_moves = move_count && move_count == moves.size();
+    WDL value;
+    if (no_more_moves) {
+        value = best;
+    } else {
+        value = WDL(probe_table(cr, WDL_TABLE, result));
+        if (result == FAIL) return DRAW;
+    }
+
+    if (best >= value) {
+        result = best > DRAW || no_more_moves ? ZEROING_BEST_MOVE : OK;
+        return best;
+    }
+    result = OK;
+    return value;
+}
+
+int dtz_before_zeroing(WDL wdl) {
+    return wdl == WIN ? 1 : wdl == CURSED_WIN ? 101 : wdl == BLESSED_LOSS ? -101 : wdl == LOSS ? -1 : 0;
+}
+
+int sign_of(int v) {
+    return (v > 0) - (v < 0);
+}
+
+int probe_dtz_internal(thc::ChessRules& cr, ProbeState& result) {
+    result = OK;
+    WDL wdl = search(cr, result, true);
+    if (result == FAIL || wdl == DRAW) return 0;
+    if (result == ZEROING_BEST_MOVE) return dtz_before_zeroing(wdl);
+
+    int dtz = probe_table(cr, DTZ_TABLE, result, wdl);
+    if (result == FAIL) return 0;
+    if (result != CHANGE_STM) {
+        return (dtz + 100 * (wdl == BLESSED_LOSS || wdl == CURSED_WIN)) * sign_of(wdl);
+    }
+
+    // The table is for the other side to move, take the best of one ply more
+    int min_dtz = 0xFFFF;
+    std::vector<thc::Move> moves;
+    cr.GenLegalMoveList(moves);
+    for (thc::Move& move : moves) {
+        bool zeroing = is_zeroing(cr, move);
+        cr.PushMove(move);
+        dtz = zeroing ? -dtz_before_zeroing(search(cr, result, false)) : -probe_dtz_internal(cr, result);
+
+        if (dtz == 1 && in_check(cr)) {
+            std::vector<thc::Move> replies;
+            cr.GenLegalMoveList(replies);
+            if (replies.empty()) min_dtz = 1;
+        }
+        if (!zeroing) dtz += sign_of(dtz);
+        if (dtz < min_dtz && sign_of(dtz) == sign_of(wdl)) min_dtz = dtz;
+        cr.PopMove(move);
+        if (result == FAIL) return 0;
+    }
+    return min_dtz == 0xFFFF ? -1 : min_dtz;
+}
+
+bool probeable(const thc::ChessRules& cr) {
+    return largest > 0 && !cr.wking && !cr.wqueen && !cr.bking && !cr.bqueen;
+}
+
+} // namespace
+
+int init(const std::string& path) {
+    static std::once_flag encoding;
+    std::call_once(encoding, init_encoding);
+    release_tables();
+
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find(':', start);
+        if (end == std::string::npos) end = path.size();
+        std::string directory = path.substr(start, end - start);
+        start = end + 1;
+        if (directory.empty()) continue;
+
+        DIR* dir = opendir(directory.c_str());
+        if (!dir) continue;
+        while (dirent* ent = readdir(dir)) {
+            std::string file = ent->d_name;
+            for (int type = WDL_TABLE; type <= DTZ_TABLE; type++) {
+                size_t n = file.size();
+                if (n > 5 && file.compare(n - 5, 5, SUFFIX[type]) == 0) {
+                    register_table(directory, file.substr(0, n - 5), TableType(type));
+                }
+            }
+        }
+        closedir(dir);
+    }
+    return largest;
+}
+
+int max_pieces() {
+    return largest;
+}
+
+bool probe_wdl(thc::ChessRules& cr, WDL& wdl) {
+    probe_stats.probes++;
+    if (!probeable(cr)) return false;
+    ProbeState result = OK;
+    wdl = search(cr, result, false);
+    if (result == FAIL) return false;
+    probe_stats.hits++;
+    return true;
+}
+
+bool probe_dtz(thc::ChessRules& cr, int& dtz) {
+    probe_stats.probes++;
+    if (!probeable(cr)) return false;
+    ProbeState result = OK;
+    dtz = probe_dtz_internal(cr, result);
+    if (result == FAIL) return false;
+    probe_stats.hits++;
+    return true;
+}
+
+bool filter_root_moves(thc::ChessRules& cr, std::vector<thc::Move>& moves) {
+    if (moves.empty() || !probeable(cr)) return false;
+
+    constexpr int MAX_DTZ = 1 << 18;
+    int cnt50 = cr.half_move_clock;
+    std::vector<int> ranks;
+    for (thc::Move& move : moves) {
+        bool zeroing = is_zeroing(cr, move);
+        ProbeState result = OK;
+        int dtz;
+        cr.PushMove(move);
+        if (zeroing) {
+            WDL wdl = WDL(-search(cr, result, false));
+            dtz = dtz_before_zeroing(wdl);
+        } else {
+            dtz = -probe_dtz_internal(cr, result);
+            dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
+        }
+        if (dtz == 2 && in_check(cr)) {
+            std::vector<thc::Move> replies;
+            cr.GenLegalMoveList(replies);
+            if (replies.empty()) dtz = 1;
+        }
+        cr.PopMove(move);
+        if (result == FAIL) return false;
+
+        // Wins that beat the 50 move rule come first, the quickest zeroing ahead, then the wins it turns
+        // into draws (fastest first), draws, and losses, where slower ones that it saves rank higher
+        int current50 = zeroing ? 0 : cnt50;
+        int rank = dtz > 0 ? (dtz + current50 <= 99 ? MAX_DTZ : MAX_DTZ - (dtz + current50))
+                 : dtz < 0 ? (-dtz * 2 + current50 < 100 ? -MAX_DTZ : -MAX_DTZ + (-dtz + current50))
+                 : 0;
+        if (dtz > 0 && rank == MAX_DTZ) rank -= dtz;
+        ranks.push_back(rank);
+    }
+
+    int best = *std::max_element(ranks.begin(), ranks.end());
+    std::vector<thc::Move> kept;
+    for (size_t i = 0; i < moves.size(); i++) {
+        if (ranks[i] == best) kept.push_back(moves[i]);
+    }
+    moves.swap(kept);
+    return true;
+}
+
+Stats& stats() {
+    return probe_stats;
+}
+
+} // namespace syzygy
@@ -0,0 +1,63 @@
+#ifndef TBPROBE_H
+#define TBPROBE_H
+
+#include "thc.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ *  syzygy
+ *
+ *  Probing of Syzygy endgame tablebases (.rtbw win/draw/loss and .rtbz distance to zeroing files). init
+ *  only scans the directories for table names, a file is mapped read-only and its header parsed the
+ *  first time a position with that material is probed.
+ *
+ *  The tables don't store positions with castling rights, so callers must not probe those. En passant
+ *  and captures are handled here by a small capture search on top of the table lookup.
+ */
+
+namespace syzygy {
+
+// The decoder has not been checked against real table files yet (tbcheck compares it with tbgen's tables),
+// so SerialEngine only uses the tables in builds with make SYZYGY=1. Probing them directly works in every
+// build.
+#ifdef SYZYGY_SEARCH
+constexpr bool SEARCH_ENABLED = true;
+#else
+constexpr bool SEARCH_ENABLED = false;
+#endif
+
+// From the side to move's point of view. Cursed wins and blessed losses are wins/losses that the 50 move
+// rule turns into draws.
+enum WDL { LOSS = -2, BLESSED_LOSS = -1, DRAW = 0, CURSED_WIN = 1, WIN = 2 };
+
+// Register the tables in path (directories separated by ':'), returns the largest piece count found.
+// Calling it again replaces the previous set of tables.
+int init(const std::string& path);
+
+// Largest piece count (kings included) with a table, 0 without tables
+int max_pieces();
+
+// Results of the position for the side to move, false when no table covers it
+bool probe_wdl(thc::ChessRules& cr, WDL& wdl);
+
+// Distance to zeroing in plies, signed like the WDL (positive when winning), +-101 and beyond for
+// cursed wins and blessed losses, 0 for draws
+bool probe_dtz(thc::ChessRules& cr, int& dtz);
+
+// Keep only the root moves that preserve the best result, ranked by DTZ and the 50 move counter.
+// Returns false (moves untouched) if some position could not be probed.
+bool filter_root_moves(thc::ChessRules& cr, std::vector<thc::Move>& moves);
+
+// Probe counters of the calling thread since its last reset
+struct Stats {
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+};
+
+Stats& stats();
+
+} // namespace syzygy
+
+#endif // TBPROBE_H